@@ -0,0 +1,243 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : benchmark of push, pop, read, begin methods
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  This application measures the speed of push, pop, read and begin methods
+  and the storage accesses that each of them makes, over a matrix of FIFO
+  buffer sizes, data block size distributions and FIFO fill levels.
+  The FIFO runs in RAM, through a backend that counts the bytes read and
+  written and the storage calls of each method. The results are printed
+  as a table, one line for each combination: operations per second and
+  bytes read/written per operation, for the successful operations only.
+  It runs on all boards and on a Linux host, see extras/host.
+  
+.- */
+
+#define FIFOEE_RAM      // the benchmark makes many write cycles
+
+#define BUFFER_START_ADDR 0x10
+#define BENCH_OPS 1000       // operations for each measure
+#define BENCH_BEGINS 20      // begins for each measure
+
+#include <fifoee.h>
+
+
+// storage access counters
+uint32_t devReads;
+uint32_t devWrites;
+uint32_t devCalls;
+
+// RAM backend counting the storage accesses
+struct countingBackend: FIFOEERamBackend {
+
+  uint8_t read(const uint8_t *addr) {
+    devReads++;
+    devCalls++;
+    return FIFOEERamBackend::read(addr);
+  }
+  void write(uint8_t *addr,uint8_t val) {
+    devWrites++;
+    devCalls++;
+    FIFOEERamBackend::write(addr,val);
+  }
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+    devReads += size;
+    devCalls++;
+    FIFOEERamBackend::readBlock(addr,buf,size);
+  }
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+    devWrites += size;
+    devCalls++;
+    FIFOEERamBackend::writeBlock(addr,buf,size);
+  }
+
+};
+
+typedef BasicFIFOEE<countingBackend> benchFIFOEE;
+
+// benchmark matrix
+#ifdef __AVR__
+const size_t bufferSizes[] = { 64, 256, 512 };
+#else
+const size_t bufferSizes[] = { 64, 256, 1024, 4096 };
+#endif
+const uint8_t fillLevels[] = { 25, 50, 90 };  // percent of ring buffer
+
+// block size distributions: fixed 8 bytes, uniform 1-16, uniform 1-127
+const char *distNames[] = { "fix8", "1-16", "1-127" };
+#define DIST_COUNT 3
+
+// a single data block
+uint8_t data[FIFOEE_DATA_SIZE_MAX];
+
+// measures of a method
+struct measure {
+
+  uint32_t time;     // us
+  uint32_t ops;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t calls;
+
+};
+
+char line[120];
+uint32_t startTime;
+
+
+size_t blockDataSize(uint8_t dist) {
+/* data size of the next block by the given distribution
+ */
+
+  switch (dist) {
+    case 0: return 8;
+    case 1: return rand() % 16 + 1;
+    default: return rand() % FIFOEE_DATA_SIZE_MAX + 1;
+  }
+
+}
+
+
+void startMeasure(void) {
+
+  devReads = 0;
+  devWrites = 0;
+  devCalls = 0;
+  startTime = micros();
+
+}
+
+
+void stopMeasure(measure *m,int error) {
+/* add the time and the storage accesses of an operation to its measures,
+ * if the operation succeeded
+ */
+
+  uint32_t time = micros() - startTime;
+  if (error)
+    return;
+
+  m->ops++;
+  m->time += time;
+  m->reads += devReads;
+  m->writes += devWrites;
+  m->calls += devCalls;
+
+}
+
+
+void printMeasure(const char *name,measure *m) {
+/* print operations per second and storage bytes per operation
+ */
+
+  if (!m->ops)
+    return;
+  if (!m->time)
+    m->time = 1;
+  snprintf(line,sizeof(line)," %s %7lu/s r%4lu w%4lu c%3lu",name,
+    (unsigned long)((uint64_t)m->ops * 1000000 / m->time),
+    (unsigned long)(m->reads / m->ops),(unsigned long)(m->writes / m->ops),
+    (unsigned long)(m->calls / m->ops));
+  Serial.print(line);
+
+}
+
+
+void bench(benchFIFOEE &fifo,size_t bufSize,uint8_t dist,uint8_t fill) {
+/* measure all methods for a buffer size, a block size distribution and
+ * a fill level
+ */
+
+  measure push = {}, pop = {}, read = {}, begin = {};
+  fifo.format();
+  fifo.begin();
+  size_t fillBytes = (bufSize - METADATA_SIZE) * fill / 100;
+
+  // fill the FIFO up to the fill level
+  while (fifo.bytesUsed() < fillBytes)
+    if (fifo.push(data,blockDataSize(dist)))
+      break;
+
+  // push a block and pop a block, keeping the fill level
+  for (int i = 0; i < BENCH_OPS; i++) {
+
+    size_t size = blockDataSize(dist);
+    startMeasure();
+    int error = fifo.push(data,size);
+    stopMeasure(&push,error);
+
+    if (fifo.bytesUsed() >= fillBytes || error) {
+      size = sizeof(data);
+      startMeasure();
+      error = fifo.pop(data,&size);
+      stopMeasure(&pop,error);
+    }
+  }
+
+  // read all blocks, more times
+  for (int i = 0; i < BENCH_OPS; i++) {
+
+    size_t size = sizeof(data);
+    startMeasure();
+    int error = fifo.read(data,&size);
+    stopMeasure(&read,error);
+    if (error)
+      fifo.restartRead();
+  }
+
+  // begin
+  for (int i = 0; i < BENCH_BEGINS; i++) {
+    startMeasure();
+    int error = fifo.begin();
+    stopMeasure(&begin,error);
+  }
+
+  snprintf(line,sizeof(line),"%5u %-5s %2u%%",(unsigned)bufSize,
+    distNames[dist],fill);
+  Serial.print(line);
+  printMeasure("push",&push);
+  printMeasure("pop",&pop);
+  printMeasure("read",&read);
+  printMeasure("begin",&begin);
+  Serial.println();
+
+}
+
+
+void setup()
+{
+  // initialize serial
+  Serial.begin(9600);
+  delay(1000);
+
+  Serial.println("size dist  fill, for each method: ops/s, bytes read (r), "
+    "written (w), storage calls (c) per op");
+
+  // one FIFO for each buffer size, formatted again at each measure
+  srand(1);
+  for (size_t i = 0; i < sizeof(bufferSizes) / sizeof(bufferSizes[0]); i++) {
+    benchFIFOEE *fifo = new benchFIFOEE((uint8_t *)BUFFER_START_ADDR,
+      bufferSizes[i]);
+    for (uint8_t dist = 0; dist < DIST_COUNT; dist++)
+      for (size_t j = 0; j < sizeof(fillLevels); j++)
+        bench(*fifo,bufferSizes[i],dist,fillLevels[j]);
+  }
+
+  Serial.println("Done");
+}
+
+
+void loop()
+{
+  delay(1000);
+}
+
+/**** END ****/
@@ -0,0 +1,277 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : check push, pop, read, begin, compact, truncate against a model
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  This application runs random sequences of push, pop, read, begin, compact
+  and truncate over a FIFO in RAM and checks each result against a
+  reference model: a queue of block serial numbers and sizes, from which
+  the content of each block is computed, so the model needs a few bytes
+  for each block. Each returned error code, data size and data byte is
+  compared with the model, the mismatches are printed and counted.
+  It runs on all boards and on a Linux host, see extras/host. With
+  MODEL_CHECK_EEPROM defined, the FIFO is the default one over EEPROM,
+  flushed before each begin: on a host, the emulated EEPROM of
+  extras/host is also power cycled, so begin finds only committed data.
+
+.- */
+
+#ifndef MODEL_CHECK_EEPROM
+#define FIFOEE_RAM      // the check makes many write cycles
+#endif
+
+#define BUFFER_START_ADDR 0x10
+#define BUFFER_SIZE 300
+#define CHECK_OPS 20000      // operations for each check cycle
+#define CHECK_CYCLES 4
+#define MAX_DATA_SIZE 60
+#define MODEL_BLOCKS (BUFFER_SIZE / 2)  // each block takes 2 bytes at least
+
+#include <fifoee.h>
+
+
+// the FIFO checked
+FIFOEE fifo((uint8_t *)BUFFER_START_ADDR,BUFFER_SIZE);
+
+// reference model: blocks from the queue head, a circular array
+uint16_t modelSerial[MODEL_BLOCKS];
+uint8_t modelSize[MODEL_BLOCKS];
+size_t modelHead = 0;
+size_t modelCount = 0;
+size_t modelRead = 0;           // blocks read after the head
+uint16_t nextSerial = 0;
+
+// a single data block
+uint8_t data[FIFOEE_DATA_SIZE_MAX];
+
+char line[80];
+uint32_t errors = 0;
+uint32_t ops = 0;
+
+
+uint8_t blockByte(uint16_t serial,size_t i) {
+/* content of byte i of the block with the given serial number
+ */
+
+  return (uint8_t)(serial * 31 + i * 7 + 1);
+
+}
+
+
+void fail(const char *what,int code) {
+/* print and count a mismatch with the model
+ */
+
+  errors++;
+  snprintf(line,sizeof(line),"op %lu: %s (%d), blocks %u",
+    (unsigned long)ops,what,code,(unsigned)modelCount);
+  Serial.println(line);
+
+}
+
+
+bool sameBlock(size_t index,size_t size) {
+/* true if data holds the model block at the given index from the head
+ */
+
+  size_t slot = (modelHead + index) % MODEL_BLOCKS;
+  if (size != modelSize[slot])
+    return false;
+  for (size_t i = 0; i < size; i++)
+    if (data[i] != blockByte(modelSerial[slot],i))
+      return false;
+
+  return true;
+
+}
+
+
+void dropHead(void) {
+/* pop the model head block
+ */
+
+  modelHead = (modelHead + 1) % MODEL_BLOCKS;
+  modelCount--;
+  if (modelRead)
+    modelRead--;
+
+}
+
+
+void checkPush(void) {
+
+  size_t size = rand() % MAX_DATA_SIZE + 1;
+  for (size_t i = 0; i < size; i++)
+    data[i] = blockByte(nextSerial,i);
+
+  int error = fifo.push(data,size);
+  if (error == FIFOEE::FIFO_FULL) {
+    if (size + 1 < fifo.bytesFree())
+      fail("push full with room",error);
+    return;
+  }
+  if (error) {
+    fail("push",error);
+    return;
+  }
+
+  size_t slot = (modelHead + modelCount) % MODEL_BLOCKS;
+  modelSerial[slot] = nextSerial++;
+  modelSize[slot] = size;
+  modelCount++;
+
+}
+
+
+void checkPop(void) {
+
+  size_t size = sizeof(data);
+  int error = fifo.pop(data,&size);
+  if (!modelCount) {
+    if (error != FIFOEE::FIFO_EMPTY)
+      fail("pop of empty FIFO",error);
+    return;
+  }
+  if (error) {
+    fail("pop",error);
+    return;
+  }
+  if (!sameBlock(0,size))
+    fail("pop data",size);
+  dropHead();
+
+}
+
+
+void checkRead(void) {
+
+  size_t size = sizeof(data);
+  int error = fifo.read(data,&size);
+  if (modelRead == modelCount) {
+    if (error != FIFOEE::FIFO_EMPTY)
+      fail("read at tail",error);
+    fifo.restartRead();
+    modelRead = 0;
+    return;
+  }
+  if (error) {
+    fail("read",error);
+    return;
+  }
+  if (!sameBlock(modelRead,size))
+    fail("read data",size);
+  modelRead++;
+
+}
+
+
+void checkTruncate(void) {
+
+  size_t count = rand() % 5;
+  int error = fifo.truncate(count);
+  if (!modelCount) {
+    if (error != FIFOEE::FIFO_EMPTY)
+      fail("truncate of empty FIFO",error);
+    return;
+  }
+  if (error) {
+    fail("truncate",error);
+    return;
+  }
+  while (count-- && modelCount)
+    dropHead();
+
+}
+
+
+void checkAll(void) {
+/* begin the FIFO again, it restarts reading from the head, then read and
+ * compare all the blocks
+ */
+
+  int error = fifo.flush();
+  if (error)
+    fail("flush",error);
+  #ifdef EEPROM_HOST_POWER_CYCLE
+  EEPROM.powerCycle();
+  #endif
+
+  error = fifo.begin();
+  if (error)
+    fail("begin",error);
+  modelRead = 0;
+
+  if (fifo.blockCount() != modelCount)
+    fail("block count",fifo.blockCount());
+
+  for (size_t i = 0; i < modelCount; i++) {
+    size_t size = sizeof(data);
+    error = fifo.read(data,&size);
+    if (error) {
+      fail("read all",error);
+      break;
+    }
+    if (!sameBlock(i,size))
+      fail("read all data",size);
+  }
+  fifo.restartRead();
+
+}
+
+
+void setup()
+{
+  // initialize serial
+  Serial.begin(9600);
+  delay(1000);
+
+  srand(1);
+  for (int cycle = 0; cycle < CHECK_CYCLES; cycle++) {
+
+    fifo.format();
+    fifo.begin();
+    modelHead = 0;
+    modelCount = 0;
+    modelRead = 0;
+
+    for (ops = 0; ops < CHECK_OPS; ops++) {
+      int op = rand() % 100;
+      if (op < 40)
+        checkPush();
+      else if (op < 70)
+        checkPop();
+      else if (op < 90)
+        checkRead();
+      else if (op < 96)
+        checkTruncate();
+      else if (op < 98) {
+        fifo.compact();
+        checkAll();
+      }
+      else
+        checkAll();
+    }
+    checkAll();
+
+    snprintf(line,sizeof(line),"cycle %d: %lu mismatches",cycle,
+      (unsigned long)errors);
+    Serial.println(line);
+  }
+
+  Serial.println(errors ? "CHECK FAIL" : "CHECK OK");
+}
+
+
+void loop()
+{
+  delay(1000);
+}
+
+/**** END ****/
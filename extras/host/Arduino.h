@@ -0,0 +1,60 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : minimal Arduino API for host builds
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  Just what FIFOEE and its RAM examples need to run on a Linux host:
+  millis, micros, delay and a Serial printing to standard output.
+
+.- */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HEX 16
+#define DEC 10
+
+inline uint32_t micros(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return (uint32_t)(t.tv_sec * 1000000 + t.tv_nsec / 1000);
+}
+
+inline uint32_t millis(void) { return micros() / 1000; }
+
+inline void delay(uint32_t) {}
+
+struct HostSerial {
+
+  void begin(long) {}
+  void print(const char *s) { fputs(s,stdout); }
+  void print(long v,int base = DEC) { printf(base == HEX ? "%lX" : "%ld",v); }
+  void print(unsigned long v,int base = DEC) {
+    printf(base == HEX ? "%lX" : "%lu",v);
+  }
+  void print(int v,int base = DEC) { print((long)v,base); }
+  void print(unsigned int v,int base = DEC) { print((unsigned long)v,base); }
+  template <class T> void println(T v) { print(v); println(); }
+  template <class T> void println(T v,int base) { print(v,base); println(); }
+  void println(void) { putchar('\n'); }
+
+};
+
+extern HostSerial Serial;
+
+#endif
+
+/**** END ****/
@@ -0,0 +1,87 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : emulated EEPROM library for host builds
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  The EEPROM of ESP8266 boards, emulated in host RAM: reads and writes go
+  to a RAM mirror, a commit copies it to the emulated flash memory. With
+  ESP8266 defined, the default FIFOEE class builds on the host over its
+  emulated EEPROM backend. powerCycle, a host extension, reloads the
+  mirror from the flash memory, dropping the changes not committed.
+
+.- */
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include "Arduino.h"
+
+#define EEPROM_HOST_SIZE 4096
+#define EEPROM_HOST_POWER_CYCLE
+
+class EEPROMClass {
+
+  uint8_t mirror[EEPROM_HOST_SIZE];
+  uint8_t flash[EEPROM_HOST_SIZE];
+  size_t size = 0;
+  bool dirty = false;
+
+  public:
+
+  uint32_t commits = 0;
+
+  EEPROMClass() {
+    memset(mirror,0xff,sizeof(mirror));
+    memset(flash,0xff,sizeof(flash));
+  }
+
+  void begin(size_t aSize) {
+    size = aSize <= EEPROM_HOST_SIZE ? aSize : EEPROM_HOST_SIZE;
+  }
+
+  uint8_t read(int addr) { return mirror[addr]; }
+
+  void write(int addr,uint8_t val) {
+    if (mirror[addr] != val) {
+      mirror[addr] = val;
+      dirty = true;
+    }
+  }
+
+  void update(int addr,uint8_t val) { write(addr,val); }
+
+  bool commit(void) {
+    if (dirty) {
+      memcpy(flash,mirror,size);
+      dirty = false;
+      commits++;
+    }
+    return true;
+  }
+
+  uint8_t *getDataPtr(void) {
+    dirty = true;
+    return mirror;
+  }
+  const uint8_t *getConstDataPtr(void) const { return mirror; }
+  size_t length(void) { return size; }
+
+  void powerCycle(void) {
+    memcpy(mirror,flash,sizeof(mirror));
+    dirty = false;
+  }
+
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
+
+/**** END ****/
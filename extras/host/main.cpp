@@ -0,0 +1,33 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : run an Arduino sketch on a Linux host
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  The sketch given by the SKETCH symbol runs its setup only: sketches
+  for host builds do all their work in setup.
+
+.- */
+
+#include "Arduino.h"
+#include "EEPROM.h"
+
+HostSerial Serial;
+EEPROMClass EEPROM;
+
+#include SKETCH
+
+int main(void) {
+
+  setup();
+  return 0;
+
+}
+
+/**** END ****/
@@ -12,12 +12,54 @@
 .description
   FIFOEE realizes an EEPROM ring buffer for blocks of data with variable size,
   managed in FIFO mode. FIFOEE can work also with a RAM ring buffer.
+  The storage medium is given by a backend class, template argument of
+  BasicFIFOEE. The FIFOEE class is the BasicFIFOEE over the default
+  backend of the board: on chip EEPROM, emulated EEPROM or RAM.
 
 .compile_options
   1. debugging printout methods, to include them define symbol FIFOEE_DEBUG.
-  2. use RAM instead of EEPROM, to activate define symbol FIFOEE_RAM.
+  2. default FIFOEE class over RAM instead of EEPROM, to activate define
+  symbol FIFOEE_RAM.
   3. multiple instances needs explicit EEPROM begin, tell it to FIFOEE defining
   symbol EEPROM_PROGRAM_BEGIN.
+  4. fast begin from a checkpoint of FIFO pointers, to activate define symbol
+  FIFOEE_CHECKPOINT_SLOTS as the number of checkpoint slots (1-127).
+  5. RAM write back cache of EEPROM pages, to activate define symbol
+  FIFOEE_CACHE_PAGES as the number of cached pages. The page size (bytes)
+  can be set defining symbol FIFOEE_CACHE_PAGE_SIZE, default 32.
+  6. extended block header for data blocks bigger than 127 bytes, to
+  activate define symbol FIFOEE_EXTENDED_SIZE.
+  7. wear statistics of the writes to the storage medium, to activate
+  define symbol FIFOEE_WEAR_REGIONS as the number of ring buffer regions
+  with a write counter.
+  8. single producer/single consumer mode, push and pop can run
+  concurrently (i.e. push from an ISR or a task, pop from loop), to
+  activate define symbol FIFOEE_SPSC.
+  9. sequence numbers of blocks and seek by sequence number, to activate
+  define symbol FIFOEE_SEQUENCE. Optionally, define FIFOEE_SEQUENCE_INDEX
+  as the number of entries of the RAM seek index (default 16) and
+  FIFOEE_SEQUENCE_STRIDE as the blocks between entries (default 8), both
+  powers of 2.
+  10. multiple read cursors, each reading the FIFO at its own pace, to
+  activate define symbol FIFOEE_CURSORS as the number of cursors (1-255).
+  11. CRC of each block, checked by the data reads and by verify, to
+  activate define symbol FIFOEE_BLOCK_CRC as the CRC width, 8 or 16 bits.
+  12. automatic checkpoint each time the push or the pop pointer moves
+  into another ring buffer segment, bounding the begin scan, to activate
+  define symbol FIFOEE_SEGMENTS as the number of segments (2-255).
+  13. LZ compression of the data pushed by push, each block stored
+  compressed only if smaller, to activate define symbol FIFOEE_COMPRESS.
+  14. tracing of the public operations, counting calls, duration (us),
+  storage bytes read and written and block headers read for each kind of
+  operation, to activate define symbol FIFOEE_TRACE.
+  15. asynchronous EEPROM writes on AVR boards, queued in RAM and done by
+  the EEPROM ready interrupt, to activate define symbol FIFOEE_AVR_ASYNC
+  as the number of queued byte writes (1-255).
+  16. timestamp of blocks and read of the blocks since a given time, to
+  activate define symbol FIFOEE_TIMESTAMP. Optionally, define
+  FIFOEE_TIMESTAMP_INDEX as the number of entries of the RAM time index
+  (default 16) and FIFOEE_TIMESTAMP_STRIDE as the blocks between entries
+  (default 8), both powers of 2.
   These options must be defined before including fifoee.h .
 
 .- */
@@ -25,6 +67,7 @@
 #ifndef FIFOEE_H
 #define FIFOEE_H
 
+#include <string.h>
 #include "EEPROM.h"
 
 
@@ -34,6 +77,19 @@
 #define FIFOEE_DATA_SIZE_MAX 127
 #define BLOCK_SIZE_MAX FIFOEE_DATA_SIZE_MAX + 1
 
+// extended block header: size code, followed by 2 bytes data size
+#define EXTENDED_SIZE_CODE 0x7f
+#define EXTENDED_HEADER_SIZE 3
+#define EXTENDED_BLOCK_SIZE_MAX 0xffff
+#define FIFOEE_EXTENDED_DATA_SIZE_MAX \
+  (EXTENDED_BLOCK_SIZE_MAX - EXTENDED_HEADER_SIZE)
+#define FORMAT_EXTENDED 0xe1     // format marker of extended header FIFOs
+#define FORMAT_SEQUENCE 0xe2     // format marker of sequence number FIFOs
+#define FORMAT_CRC8 0xe4         // format marker of CRC-8 block FIFOs
+#define FORMAT_CRC16 0xe8        // format marker of CRC-16 block FIFOs
+#define FORMAT_COMPRESS 0xf0     // format marker of compressed block FIFOs
+#define FORMAT_TIMESTAMP 0x40    // format marker bit cleared by timestamps
+
 // block status codes
 #define FREE_BLOCK 0x80          // never pushed or pushed and then popped
 #define USED_BLOCK 0x00          // pushed and not yet popped
@@ -42,32 +98,529 @@
 #define BLOCK_STATUS_BIT 0x80
 #define BLOCK_SIZE_BITS 0x7f
 
+// segment checkpoints: the ring buffer is divided into segments, a pointer
+// moving into another segment takes a checkpoint
+#ifdef FIFOEE_SEGMENTS
+  #if FIFOEE_SEGMENTS < 2 || FIFOEE_SEGMENTS > 255
+    #error ERROR: FIFOEE_SEGMENTS out of range 2-255
+  #endif
+  #ifndef FIFOEE_CHECKPOINT_SLOTS
+    #define FIFOEE_CHECKPOINT_SLOTS 2
+  #endif
+#endif
 
-/**** macros ****/
+// checkpoint slot: sequence number, push offset, pop offset, block count, crc
+#define CHECKPOINT_SLOT_SIZE 8
+#ifdef FIFOEE_CHECKPOINT_SLOTS
+  #if FIFOEE_CHECKPOINT_SLOTS < 1 || FIFOEE_CHECKPOINT_SLOTS > 127
+    #error ERROR: FIFOEE_CHECKPOINT_SLOTS out of range 1-127
+  #endif
+  #define CHECKPOINT_SIZE (FIFOEE_CHECKPOINT_SLOTS * CHECKPOINT_SLOT_SIZE)
+#else
+  #define CHECKPOINT_SIZE 0
+#endif
 
-#ifdef FIFOEE_RAM
-  #define EE_WRITE( addr , val ) (buffer[(int)( addr )] = val)
-  #define EE_READ( addr ) (buffer[(int)( addr )])
+// sequence number: 2 bytes (lsb first) before the data of used blocks,
+// seek index with an entry every FIFOEE_SEQUENCE_STRIDE blocks
+#ifdef FIFOEE_SEQUENCE
+  #define SEQUENCE_SIZE 2
+  #ifndef FIFOEE_SEQUENCE_INDEX
+    #define FIFOEE_SEQUENCE_INDEX 16
+  #endif
+  #ifndef FIFOEE_SEQUENCE_STRIDE
+    #define FIFOEE_SEQUENCE_STRIDE 8
+  #endif
+  #if FIFOEE_SEQUENCE_INDEX & (FIFOEE_SEQUENCE_INDEX - 1) || \
+    FIFOEE_SEQUENCE_STRIDE & (FIFOEE_SEQUENCE_STRIDE - 1)
+    #error ERROR: FIFOEE_SEQUENCE_INDEX and _STRIDE must be powers of 2
+  #endif
+#else
+  #define SEQUENCE_SIZE 0
+#endif
+
+// timestamp: 4 bytes (lsb first) after the sequence number of used blocks,
+// time index with an entry every FIFOEE_TIMESTAMP_STRIDE blocks
+#ifdef FIFOEE_TIMESTAMP
+  #define TIMESTAMP_SIZE 4
+  #ifndef FIFOEE_TIMESTAMP_INDEX
+    #define FIFOEE_TIMESTAMP_INDEX 16
+  #endif
+  #ifndef FIFOEE_TIMESTAMP_STRIDE
+    #define FIFOEE_TIMESTAMP_STRIDE 8
+  #endif
+  #if FIFOEE_TIMESTAMP_INDEX & (FIFOEE_TIMESTAMP_INDEX - 1) || \
+    FIFOEE_TIMESTAMP_STRIDE & (FIFOEE_TIMESTAMP_STRIDE - 1)
+    #error ERROR: FIFOEE_TIMESTAMP_INDEX and _STRIDE must be powers of 2
+  #endif
+#else
+  #define TIMESTAMP_SIZE 0
+#endif
+
+// block CRC: 1 or 2 bytes (lsb first) after the sequence number and the
+// timestamp of used blocks, covering them, the codec and the data
+#ifdef FIFOEE_BLOCK_CRC
+  #if FIFOEE_BLOCK_CRC == 8
+    #define BLOCK_CRC_SIZE 1
+    #define BLOCK_CRC_INIT 0xff
+    #define FORMAT_CRC FORMAT_CRC8
+  #elif FIFOEE_BLOCK_CRC == 16
+    #define BLOCK_CRC_SIZE 2
+    #define BLOCK_CRC_INIT 0xffff
+    #define FORMAT_CRC FORMAT_CRC16
+  #else
+    #error ERROR: FIFOEE_BLOCK_CRC must be 8 or 16
+  #endif
+#else
+  #define BLOCK_CRC_SIZE 0
+  #define FORMAT_CRC 0
+#endif
+
+// block compression: 1 byte codec after the CRC of used blocks, raw data or
+// LZ tokens after the raw data size (LZ_RAW_SIZE_SIZE bytes, lsb first).
+// Tokens: literal run of 1-128 bytes, short match of 2-5 bytes at offset
+// 1-16, long match of 3-66 bytes at offset 1-256 (offset byte follows)
+#ifdef FIFOEE_COMPRESS
+  #define CODEC_SIZE 1
+  #define FORMAT_CODEC FORMAT_COMPRESS
+#else
+  #define CODEC_SIZE 0
+  #define FORMAT_CODEC 0
+#endif
+#define CODEC_RAW 0
+#define CODEC_LZ 1
+#define LZ_MATCH 0x80
+#define LZ_LONG 0x40
+#define LZ_LITERAL_MAX 128
+#define LZ_SHORT_SIZE_MAX 5
+#define LZ_SHORT_OFFSET_MAX 16
+#define LZ_MATCH_MAX 66
+#define LZ_WINDOW 256
+#ifdef FIFOEE_EXTENDED_SIZE
+  #define LZ_RAW_SIZE_SIZE 2
+#else
+  #define LZ_RAW_SIZE_SIZE 1
+#endif
+
+// read cursors: RAM read pointers, each opened and advanced by its reader
+#ifdef FIFOEE_CURSORS
+  #if FIFOEE_CURSORS < 1 || FIFOEE_CURSORS > 255
+    #error ERROR: FIFOEE_CURSORS out of range 1-255
+  #endif
+#endif
+
+// metadata before ring buffer: bottom block offset, format marker, checkpoint
+#ifdef FIFOEE_EXTENDED_SIZE
+  #define BOT_OFFSET_SIZE 2
+  #define PUSH_DATA_SIZE_MAX \
+    (FIFOEE_EXTENDED_DATA_SIZE_MAX - SEQUENCE_SIZE - TIMESTAMP_SIZE - \
+    BLOCK_CRC_SIZE - CODEC_SIZE)
+#else
+  #define BOT_OFFSET_SIZE 1
+  #define PUSH_DATA_SIZE_MAX \
+    (FIFOEE_DATA_SIZE_MAX - SEQUENCE_SIZE - TIMESTAMP_SIZE - \
+    BLOCK_CRC_SIZE - CODEC_SIZE)
+#endif
+
+// format marker: bitwise or of the markers of the block layout options,
+// with the timestamp bit cleared if blocks have timestamps
+#if defined(FIFOEE_EXTENDED_SIZE) && defined(FIFOEE_SEQUENCE)
+  #define FORMAT_LAYOUT (FORMAT_EXTENDED | FORMAT_SEQUENCE)
+#elif defined(FIFOEE_EXTENDED_SIZE)
+  #define FORMAT_LAYOUT FORMAT_EXTENDED
+#elif defined(FIFOEE_SEQUENCE)
+  #define FORMAT_LAYOUT FORMAT_SEQUENCE
+#else
+  #define FORMAT_LAYOUT 0
+#endif
+#if FORMAT_LAYOUT | FORMAT_CRC | FORMAT_CODEC
+  #define FORMAT_OPTIONS (FORMAT_LAYOUT | FORMAT_CRC | FORMAT_CODEC)
+#elif defined(FIFOEE_TIMESTAMP)
+  #define FORMAT_OPTIONS 0xe0
+#endif
+#ifdef FIFOEE_TIMESTAMP
+  #define FORMAT_TYPE (FORMAT_OPTIONS & ~FORMAT_TIMESTAMP)
+#elif defined(FORMAT_OPTIONS)
+  #define FORMAT_TYPE FORMAT_OPTIONS
+#endif
+#ifdef FORMAT_TYPE
+  #define FORMAT_MARKER_SIZE 1
+#else
+  #define FORMAT_MARKER_SIZE 0
+#endif
+#define METADATA_SIZE (BOT_OFFSET_SIZE + FORMAT_MARKER_SIZE + CHECKPOINT_SIZE)
+
+// EEPROM access goes through the page cache, if present
+#if defined(FIFOEE_CACHE_PAGES) && !defined(FIFOEE_RAM)
+  #define FIFOEE_CACHE
+  #ifndef FIFOEE_CACHE_PAGE_SIZE
+    #define FIFOEE_CACHE_PAGE_SIZE 32
+  #endif
+#endif
+
+// popped blocks merged into the free block before them, if the merged
+// block keeps a one byte header. Not with checkpoints, that count the
+// popped blocks, and not in SPSC mode, where free blocks are of push side
+#if !defined(FIFOEE_CHECKPOINT_SLOTS) && !defined(FIFOEE_SPSC)
+  #define FIFOEE_COALESCE
+  #ifdef FIFOEE_EXTENDED_SIZE
+    #define COALESCE_SIZE_MAX EXTENDED_SIZE_CODE
+  #else
+    #define COALESCE_SIZE_MAX (BLOCK_SIZE_MAX)
+  #endif
+#endif
+
+// operation tracing: a trace scope at the start of each traced method,
+// nothing if tracing is off
+#ifdef FIFOEE_TRACE
+  #define TRACE_OPERATION(op) traceScope opTrace(this,op)
 #else
+  #define TRACE_OPERATION(op)
+#endif
+
+// single producer/single consumer: push and pop sides share only the
+// published pointers and counters
+#ifdef FIFOEE_SPSC
+  #if defined(FIFOEE_CACHE) || defined(FIFOEE_CHECKPOINT_SLOTS) || \
+    defined(FIFOEE_WEAR_REGIONS) || defined(FIFOEE_SEQUENCE) || \
+    defined(FIFOEE_TRACE) || defined(FIFOEE_TIMESTAMP)
+    #error ERROR: FIFOEE_SPSC excludes cache, checkpoint, wear, sequence, \
+      trace and timestamp
+  #endif
   #ifdef __AVR__
-    #define EE_WRITE( addr , val ) (EEPROM[ (int)( addr )  ].update( val ))
-  #elif defined(ESP8266) || defined(ESP32)
-    #define EE_WRITE( addr , val ) (EEPROM.write((int)( addr ),( val )))
+    #include <util/atomic.h>
+  #endif
+#endif
+
+
+/**** storage backends ****/
+
+/* A backend gives to BasicFIFOEE the access to a storage medium, addresses
+ * are pointers counted from the medium start. Member functions:
+ *   begin(size): make the first size bytes of the medium accessible.
+ *   read(addr), write(addr,val): read and write (if changed) a byte.
+ *   readBlock(addr,buf,size), writeBlock(addr,buf,size): read and write
+ *     size contiguous bytes in a single burst.
+ *   changed(size): a FIFO operation changed size bytes.
+ *   commitDue(): true if the changes must be committed now.
+ *   pending(): true if there are changes not yet committed.
+ *   commit(): commit the changes, return false on failure.
+ *   dataPtr(addr): optional, direct pointer to the medium, used by peek.
+ *   updateInPlace: optional static constant, true if write and writeBlock
+ *     skip the bytes that do not change, so the wear statistics count
+ *     only the changed bytes.
+ */
+
+struct FIFOEERamBackend {
+/* FIFO into a RAM buffer, allocated at the first begin. The buffer spans
+ * from address zero to the FIFO end, as the EEPROM does.
+ */
+
+  uint8_t *buffer = NULL;
+
+  // the commit period is ignored, accepted as the emulated EEPROM does
+  explicit FIFOEERamBackend(uint32_t = 0) {}
+
+  void begin(size_t size) {
+    if (!buffer)
+      buffer = (uint8_t *)malloc(size);
+  }
+
+  uint8_t read(const uint8_t *addr) { return buffer[(size_t)addr]; }
+  void write(uint8_t *addr,uint8_t val) { buffer[(size_t)addr] = val; }
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+    memcpy(buf,buffer + (size_t)addr,size);
+  }
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+    memcpy(buffer + (size_t)addr,buf,size);
+  }
+  const uint8_t *dataPtr(const uint8_t *addr) {
+    return buffer + (size_t)addr;
+  }
+
+  // RAM needs no commit
+  void changed(size_t) {}
+  bool commitDue(void) { return false; }
+  bool pending(void) { return false; }
+  bool commit(void) { return true; }
+
+};
+
+
+#ifdef __AVR__
+#include <avr/eeprom.h>
+
+// asynchronous writes: a RAM queue of byte writes, shared by all the FIFOs,
+// done in order by the EEPROM ready interrupt, one per write cycle
+#ifdef FIFOEE_AVR_ASYNC
+  #if FIFOEE_AVR_ASYNC < 1 || FIFOEE_AVR_ASYNC > 255
+    #error ERROR: FIFOEE_AVR_ASYNC out of range 1-255
+  #endif
+  #ifdef FIFOEE_SPSC
+    #error ERROR: FIFOEE_AVR_ASYNC excludes FIFOEE_SPSC
+  #endif
+  #include <avr/interrupt.h>
+  #include <util/atomic.h>
+
+struct FIFOEEAvrWrite {
+
+  uint8_t *addr;
+  uint8_t val;
+
+};
+
+volatile FIFOEEAvrWrite fifoeeWrites[FIFOEE_AVR_ASYNC];
+volatile uint8_t fifoeeWriteHead = 0;     // oldest queued write
+volatile uint8_t fifoeeWriteCount = 0;    // queued writes
+
+
+ISR(EE_READY_vect) {
+/* start the write of the oldest queued byte, if any, otherwise stop the
+ * interrupt. A byte not changed is not written and the interrupt fires
+ * again at once for the next one.
+ */
+
+  if (!fifoeeWriteCount) {
+    EECR &= ~_BV(EERIE);
+    return;
+  }
+
+  uint8_t head = fifoeeWriteHead;
+  eeprom_update_byte(fifoeeWrites[head].addr,fifoeeWrites[head].val);
+  fifoeeWriteHead = head + 1 < FIFOEE_AVR_ASYNC ? head + 1 : 0;
+  fifoeeWriteCount--;
+
+}
+#endif
+
+
+struct FIFOEEAvrBackend {
+/* FIFO into the on chip EEPROM of AVR boards, bytes are written only if
+ * changed. In SPSC mode, push and pop sides can access the EEPROM from
+ * an ISR and from loop: each byte access is done with interrupts disabled,
+ * after waiting outside of it for the end of any write cycle.
+ * With asynchronous writes, a write goes to the RAM queue and returns,
+ * waiting only for a free queue entry. The queue is drained in order by
+ * the EEPROM ready interrupt, so the block header written last by a push
+ * reaches the EEPROM last. Reads get the newest queued value of a byte,
+ * if any: they pause the drain and wait for the write cycle in progress
+ * with interrupts enabled. The changes are pending until the queue is
+ * empty, a commit waits for it.
+ */
+
+  // the EEPROM cells are rewritten only if their value changes
+  static const bool updateInPlace = true;
+
+  void begin(size_t) {}
+
+  #ifdef FIFOEE_AVR_ASYNC
+  uint8_t read(const uint8_t *addr) {
+    // pause the queue drain, so no write cycle starts after the wait for
+    // the one in progress, done with interrupts enabled
+    uint8_t val;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      EECR &= ~_BV(EERIE);
+    }
+    eeprom_busy_wait();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (!queued(addr,&val))
+        val = eeprom_read_byte(addr);
+      if (fifoeeWriteCount)
+        EECR |= _BV(EERIE);
+    }
+    return val;
+  }
+  void write(uint8_t *addr,uint8_t val) {
+    while (fifoeeWriteCount == FIFOEE_AVR_ASYNC)
+      ;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      uint8_t tail = (fifoeeWriteHead + fifoeeWriteCount) % FIFOEE_AVR_ASYNC;
+      fifoeeWrites[tail].addr = addr;
+      fifoeeWrites[tail].val = val;
+      fifoeeWriteCount++;
+      EECR |= _BV(EERIE);
+    }
+  }
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+    while (size--)
+      *buf++ = read(addr++);
+  }
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+    while (size--)
+      write(addr++,*buf++);
+  }
+  bool queued(const uint8_t *addr,uint8_t *val) {
+    // newest queued write of the byte, with interrupts disabled
+    for (uint8_t i = fifoeeWriteCount; i--;) {
+      uint8_t entry = (fifoeeWriteHead + i) % FIFOEE_AVR_ASYNC;
+      if (fifoeeWrites[entry].addr == addr) {
+        *val = fifoeeWrites[entry].val;
+        return true;
+      }
+    }
+    return false;
+  }
+  #elif defined(FIFOEE_SPSC)
+  uint8_t read(const uint8_t *addr) {
+    uint8_t val;
+    eeprom_busy_wait();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      val = eeprom_read_byte(addr);
+    }
+    return val;
+  }
+  void write(uint8_t *addr,uint8_t val) {
+    eeprom_busy_wait();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      eeprom_update_byte(addr,val);
+    }
+  }
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+    while (size--)
+      *buf++ = read(addr++);
+  }
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+    while (size--)
+      write(addr++,*buf++);
+  }
   #else
-    #error ERROR: unsupported architecture 
+  uint8_t read(const uint8_t *addr) { return eeprom_read_byte(addr); }
+  void write(uint8_t *addr,uint8_t val) { eeprom_update_byte(addr,val); }
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+    eeprom_read_block(buf,addr,size);
+  }
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+    eeprom_update_block(buf,addr,size);
+  }
   #endif
-  #ifdef ESP32
-    #define EE_READ( addr ) (EEPROM.read((int)( addr )))
+
+  // a true EEPROM needs no commit, with asynchronous writes a commit
+  // waits for the end of the queued writes
+  void changed(size_t) {}
+  bool commitDue(void) { return false; }
+  #ifdef FIFOEE_AVR_ASYNC
+  bool pending(void) { return fifoeeWriteCount; }
+  bool commit(void) {
+    while (fifoeeWriteCount)
+      ;
+    eeprom_busy_wait();
+    return true;
+  }
   #else
-    #define EE_READ( addr ) (EEPROM[(int)( addr )])
+  bool pending(void) { return false; }
+  bool commit(void) { return true; }
   #endif
-  #include "EEPROM.h"
+
+};
+#endif
+
+
+#if defined(ESP8266) || defined(ESP32)
+struct FIFOEEEspBackend {
+/* FIFO into the EEPROM emulated in flash memory by ESP8266 and ESP32
+ * boards. Changes go to the RAM mirror of the emulated EEPROM and are
+ * written to flash by a commit. The first change after a commit sets
+ * the commit deadline, one commit period later: all changes up to the
+ * deadline are coalesced into a single commit. A commit is also due as
+ * soon as the changed bytes reach the commit threshold, if any.
+ */
+
+  uint32_t commitDeadline = 0;
+  uint32_t commitPeriod;
+  uint32_t commits = 0;
+  size_t commitThreshold = 0;
+  size_t dirtyBytes = 0;
+  bool dirty = false;
+  bool eepromBegin = true;
+
+  explicit FIFOEEEspBackend(uint32_t aCommitPeriod = 0):
+    commitPeriod(aCommitPeriod) {}
+
+  void begin(size_t size) {
+
+    // if required, begin EEPROM
+    #ifndef EEPROM_PROGRAM_BEGIN
+    if (eepromBegin) {
+      #if defined ESP8266
+      EEPROM.begin(size);
+      #elif defined(ESP32)
+      if (!EEPROM.begin(size)) {
+        Serial.println("ERROR: EEPROM init failure");
+        while(true) delay(1000);
+      }
+      delay(500);
+      #endif
+      eepromBegin = false;
+    }
+    #endif
+
+  }
+
+  uint8_t read(const uint8_t *addr) { return *dataPtr(addr); }
+  void write(uint8_t *addr,uint8_t val) {
+    EEPROM.write((int)(size_t)addr,val);
+  }
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+    memcpy(buf,dataPtr(addr),size);
+  }
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+    #ifdef ESP32
+    EEPROM.writeBytes((int)(size_t)addr,buf,size);
+    #else
+    for (size_t i = 0; i < size; i++)
+      EEPROM.write((int)(size_t)addr + i,buf[i]);
+    #endif
+  }
+  const uint8_t *dataPtr(const uint8_t *addr) {
+    #ifdef ESP32
+    return (const uint8_t *)EEPROM.getDataPtr() + (int)(size_t)addr;
+    #else
+    return EEPROM.getConstDataPtr() + (int)(size_t)addr;
+    #endif
+  }
+
+  void changed(size_t size) {
+    if (!dirty) {
+      dirty = true;
+      commitDeadline = millis() + commitPeriod;
+    }
+    dirtyBytes += size;
+  }
+
+  bool commitDue(void) {
+    if (!dirty)
+      return false;
+    if (commitThreshold && dirtyBytes >= commitThreshold)
+      return true;
+    return commitPeriod && (int32_t)(millis() - commitDeadline) >= 0;
+  }
+
+  bool pending(void) { return dirty; }
+
+  bool commit(void) {
+    // on failure the changes stay pending, retried by the next commit
+    if (!EEPROM.commit())
+      return false;
+    dirty = false;
+    dirtyBytes = 0;
+    commits++;
+    return true;
+  }
+
+  void setCommitThreshold(size_t maxDirtyBytes) {
+    commitThreshold = maxDirtyBytes;
+  }
+
+  uint32_t commitCount(void) { return commits; }
+
+};
 #endif
 
 
 /**** class ****/
 
-struct FIFOEE {
+struct FIFOEEBase {
+/* FIFOEE definitions independent from the storage backend
+ */
 
   /**** class constants ****/
 
@@ -83,10 +636,96 @@ struct FIFOEE {
     DATA_BUFFER_SMALL,
     PUSH_BLOCK_NOT_FREE,
     UNCLOSED_BLOCK_LIST,
-    WRONG_RBUFFER_SIZE
+    WRONG_RBUFFER_SIZE,
+    INVALID_CHECKPOINT,
+    INVALID_DATA_SIZE,
+    INVALID_FORMAT,
+    COMMIT_FAILURE,
+    NO_PARTITION_SPACE,
+    INVALID_SEQUENCE,
+    NO_FREE_CURSOR,
+    INVALID_CURSOR,
+    UNREAD_BLOCK,
+    IN_PROGRESS,
+    INVALID_BLOCK_CRC,
+    PUSH_OPEN,
+    PUSH_NOT_OPEN,
+    READ_NOT_OPEN,
+    COMPRESSED_BLOCK
+
+  };
+
+  #ifdef FIFOEE_CURSORS
+  // what pops do with the blocks not yet read by all the open cursors
+  enum cursorPolicy: uint8_t {
+
+    CURSORS_HOLD = 0,   // pop waits for the slowest cursor
+    CURSORS_SKIP        // pop moves the slowest cursors past popped blocks
+
+  };
+  #endif
+
+  // a data block descriptor, used by batched operations
+  struct dataBlock {
+
+    uint8_t *data;
+    size_t size;
 
   };
 
+  #ifdef FIFOEE_WEAR_REGIONS
+  // counters of the writes to the storage medium, since object creation
+  struct wearStats {
+
+    uint32_t bytesWritten;                      // all bytes written
+    uint32_t commits;                           // commits of changes
+    size_t regionSize;                          // bytes of each region
+    uint32_t regionWrites[FIFOEE_WEAR_REGIONS]; // bytes written per region
+    uint32_t metadataWrites[METADATA_SIZE];     // writes per metadata byte
+
+  };
+  #endif
+
+  #ifdef FIFOEE_TRACE
+  // kinds of traced operations
+  enum traceOperation: uint8_t {
+
+    TRACE_PUSH = 0,     // push, pushBatch, pushSpans, streaming push
+    TRACE_POP,          // pop, popN, popUntil, consume, truncate, clear
+    TRACE_READ,         // read, peek, seek, streaming read, cursor read
+    TRACE_BEGIN,        // begin, beginStart, beginStep
+    TRACE_COMMIT,       // commits of changes, by any operation
+    TRACE_OTHER,        // format, compact, verify
+    TRACE_OPERATIONS
+
+  };
+
+  // counters of a kind of operation, since object creation. The counters
+  // of an operation do not include the nested operations of other kinds,
+  // i.e. the commit done by a push
+  struct traceStats {
+
+    uint32_t calls;                 // operations done
+    uint32_t totalMicros;           // duration of all operations (us)
+    uint32_t maxMicros;             // duration of the longest one (us)
+    uint32_t bytesRead;             // bytes read from the storage medium
+    uint32_t bytesWritten;          // bytes written to the storage medium
+    uint32_t headers;               // block headers read
+
+  };
+  #endif
+
+};
+
+
+template <class Backend>
+struct BasicFIFOEE: FIFOEEBase {
+
+  public:
+
+  // the storage backend class
+  typedef Backend backendType;
+
   private:
 
   /**** class control vars ****/
@@ -94,6 +733,7 @@ struct FIFOEE {
   uint8_t *pBlock;
   uint8_t blockHeader;
   uint8_t blockStatus;
+  uint8_t headerSize;
   size_t blockSize;
   uint8_t *pBotBlock;
   uint8_t *pBotBlockOffset;
@@ -106,47 +746,150 @@ struct FIFOEE {
   uint8_t *pPop;
   uint8_t *pRead;
 
-  #if (defined(ESP8266) || defined(ESP32)) && !defined FIFOEE_RAM
-  uint32_t nextCommit = 0;
-  uint32_t commitPeriod;
-  bool eepromBegin = true;
+  // state of the begin scan, kept between steps
+  uint8_t scanStatus;
+  size_t scanSize;
+
+  // state of the begin index rebuild: next block, its number from the
+  // FIFO queue head. pIndex is NULL until the rebuild starts.
+  #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP)
+  uint8_t *pIndex;
+  size_t indexNum;
   #endif
 
-  #ifdef FIFOEE_RAM
-  uint8_t *buffer;
+  #ifdef FIFOEE_CHECKPOINT_SLOTS
+  uint8_t *pCheckpoint;
+  uint8_t cpSeq;
+  uint8_t cpSlot;
+  bool cpValid;
+  size_t cpPushOffset;
+  size_t cpPopOffset;
+  size_t cpFree;
+  size_t cpPushed;
+  size_t cpBlockCount;
   #endif
 
+  #ifdef FIFOEE_SEGMENTS
+  size_t segmentSize;
+  #endif
 
-  /**** class member functions ****/
+  size_t usedBlocks;
 
-  public:
+  #ifdef FIFOEE_COALESCE
+  uint8_t *pFreeTail;             // free block ending at pPop, if known
+  size_t freeTailSize;
+  #endif
 
-  #if defined(ESP8266) || defined(ESP32)
-  FIFOEE(uint8_t *aBuffer,size_t aBufSize,uint32_t aCommitPeriod) {
+  #ifdef FIFOEE_SPSC
+  size_t pushedBytes = 0;         // bytes changed by push side
+  size_t pushedBytesSeen = 0;     // pushed bytes already told to backend
   #else
-  FIFOEE(uint8_t *aBuffer,size_t aBufSize) {
+  bool overwrite = false;         // push drops oldest blocks if full
+  #endif
+
+  #ifdef FIFOEE_COMPRESS
+  bool compression = true;        // push stores LZ encoded data
+  #endif
+
+  // streaming push: reserved block size, zero if none, data offset into
+  // the block and data bytes written
+  size_t streamSize = 0;
+  size_t streamData;
+  size_t streamWritten;
+  #ifdef FIFOEE_BLOCK_CRC
+  uint16_t streamCrc;
   #endif
+
+  // streaming read: next data byte of the open read block, NULL if none,
+  // data bytes left and next block
+  uint8_t *pChunk = NULL;
+  size_t chunkLeft;
+  uint8_t *pChunkNext;
+  #ifdef FIFOEE_BLOCK_CRC
+  uint16_t chunkCrc;
+  uint16_t chunkBlockCrc;
+  #endif
+
+  #ifdef FIFOEE_SEQUENCE
+  uint16_t headSeq;               // sequence number of pop block
+  uint16_t tailSeq;               // sequence number of next pushed block
+  uint16_t seqIndex[FIFOEE_SEQUENCE_INDEX];  // offsets, a block every stride
+  #endif
+
+  #ifdef FIFOEE_TIMESTAMP
+  uint32_t (*clockSource)(void) = NULL;   // timestamp source, NULL for millis
+  uint32_t pushTime;              // timestamp of the block being pushed
+  uint16_t headStamp;             // time index number of pop block
+  uint16_t tailStamp;             // time index number of next pushed block
+  uint16_t timeOffsets[FIFOEE_TIMESTAMP_INDEX];  // offsets, every stride
+  uint32_t timeIndex[FIFOEE_TIMESTAMP_INDEX];    // timestamps of them
+  #endif
+
+  #ifdef FIFOEE_CURSORS
+  uint8_t *pCursor[FIFOEE_CURSORS];  // read pointers, NULL if not open
+  uint8_t cursorMode = CURSORS_HOLD;
+  #endif
+
+  Backend dev;
+
+  #ifdef FIFOEE_WEAR_REGIONS
+  wearStats wear;
+  #endif
+
+  #ifdef FIFOEE_TRACE
+  struct traceScope;
+  traceStats trace[TRACE_OPERATIONS];
+  traceScope *traceTop;           // innermost running operation, if any
+  #endif
+
+  #ifdef FIFOEE_CACHE
+  struct cacheLine {
+
+    uint8_t *page;
+    bool dirty;
+    uint16_t used;
+    uint16_t modified;
+    uint8_t data[FIFOEE_CACHE_PAGE_SIZE];
+
+  } cache[FIFOEE_CACHE_PAGES];
+  uint16_t cacheClock = 0;
+  #endif
+
+
+  /**** class member functions ****/
+
+  public:
+
+  BasicFIFOEE(uint8_t *aBuffer,size_t aBufSize) {
   /* class constructor
    * aBuffer: FIFO buffer start address, area for control var and ring buffer.
    * aBufSize: buffer size (bytes).
-   * aCommitPeriod: (ESP8266 and ESP32 only) real write to EEPROM happens every
-   *   period.
    */
 
-    #ifdef FIFOEE_RAM
-      buffer = (uint8_t *)malloc((int)aBuffer + aBufSize);
-    #endif
+    init(aBuffer,aBufSize);
 
-    // allocate and init control vars
-    pBotBlockOffset = aBuffer;
-    rBufSize = aBufSize - 1;
-    pRBufStart = aBuffer + 1;
-    pRBufEnd = pRBufStart + rBufSize;
+  }
 
-    #if (defined(ESP8266) || defined(ESP32)) && !defined FIFOEE_RAM
-    commitPeriod = aCommitPeriod;
-    nextCommit = millis() + commitPeriod;
-    #endif
+
+  BasicFIFOEE(uint8_t *aBuffer,size_t aBufSize,uint32_t aCommitPeriod):
+    dev(aCommitPeriod) {
+  /* class constructor for emulated EEPROM (ESP8266 and ESP32)
+   * aCommitPeriod: max delay (ms) from a change to its real write to
+   *   EEPROM (commit), zero disables timed commits.
+   */
+
+    init(aBuffer,aBufSize);
+
+  }
+
+
+  BasicFIFOEE(uint8_t *aBuffer,size_t aBufSize,const Backend &aDev):
+    dev(aDev) {
+  /* class constructor with a given backend instance
+   * aDev: backend, i.e. an external EEPROM with its bus address.
+   */
+
+    init(aBuffer,aBufSize);
 
   }
 
@@ -155,39 +898,45 @@ struct FIFOEE {
   /* format essential metadata of ring buffer, buffer is logically cleared.
    * Fill the ring buffer with a chain of forward linked free blocks with
    * a prefixed data size of FIFOEE_DATA_SIZE_MAX and a final block with
-   * a proper size to fill all ring buffer.
+   * a proper size to fill all ring buffer. With extended headers, free
+   * blocks have the maximum extended size.
    */
 
+    TRACE_OPERATION(TRACE_OTHER);
+
     // check for valid buffer size: minimum size 5 bytes, a FIFO of one block
     // of one byte of data (not very useful :).
     if (rBufSize < BUFFER_SIZE_MIN - 1)
       return INVALID_FIFO_BUFFER_SIZE;
 
-    // if required, begin EEPROM
-    #ifndef EEPROM_PROGRAM_BEGIN
-    #if !defined(FIFOEE_RAM) && !defined(__AVR__)
-    if (eepromBegin) {
-      #if defined ESP8266
-      EEPROM.begin((size_t)pRBufStart + rBufSize);
-      #elif defined(ESP32)
-      if (!EEPROM.begin((size_t)pRBufStart + rBufSize)) {
-        Serial.println("ERROR: EEPROM init failure");
-        while(true) delay(1000);
-      }
-      delay(500);
-      #endif
-      eepromBegin = false;
-    }
-    #endif
+    // extended headers: offsets must fit into 16 bits
+    #ifdef FIFOEE_EXTENDED_SIZE
+    if (rBufSize > EXTENDED_BLOCK_SIZE_MAX)
+      return INVALID_FIFO_BUFFER_SIZE;
     #endif
 
-    // clear the offset of bottommost block
-    EE_WRITE(pBotBlockOffset,0);
+    // make the storage medium accessible up to the FIFO end
+    dev.begin((size_t)pRBufEnd);
+
+    // clear the offset of bottommost block and mark the format type
+    writeBotOffset(0);
+    #ifdef FORMAT_TYPE
+    eeWrite(pBotBlockOffset + BOT_OFFSET_SIZE,FORMAT_TYPE);
+    #endif
 
     // init pointers for an empty ring buffer
     pPush = pRBufStart;
     pPop = pPush;
     pRead = pPush;
+    usedBlocks = 0;
+    streamSize = 0;
+    pChunk = NULL;
+    #ifdef FIFOEE_CURSORS
+    restartCursors();
+    #endif
+    #ifdef FIFOEE_COALESCE
+    pFreeTail = NULL;
+    #endif
 
     // insert the highest allowed number of free blocks with BLOCK_DATA_SIZE_MAX
     // byte fixed data size into the ring buffer 
@@ -195,398 +944,3451 @@ struct FIFOEE {
     size_t sizeToFill = rBufSize;
     pBlock = pRBufStart;
 
-    while (sizeToFill > BLOCK_SIZE_MAX) {
+    #ifdef FIFOEE_EXTENDED_SIZE
+    const size_t blockSizeMax = EXTENDED_BLOCK_SIZE_MAX;
+    #else
+    const size_t blockSizeMax = BLOCK_SIZE_MAX;
+    #endif
+
+    while (sizeToFill > blockSizeMax) {
+
+      writeHeader(pBlock,FREE_BLOCK,blockSizeMax);
+      pBlock += blockSizeMax;
+      sizeToFill -= blockSizeMax;
+
+    }
+
+    // set residual space
+    writeHeader(pBlock,FREE_BLOCK,sizeToFill);
+
+    // numbering starts from zero: the block before the push block holds
+    // the sequence number of the last pushed block
+    #ifdef FIFOEE_SEQUENCE
+    writeSequence(pBlock,0xffff);
+    headSeq = 0;
+    tailSeq = 0;
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    headStamp = 0;
+    tailStamp = 0;
+    #endif
+
+    // discard any previous checkpoint and take a new one of the empty FIFO
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    invalidateCheckpoint();
+    checkpoint();
+    #endif
+
+    #ifdef FIFOEE_CACHE
+    cacheFlush();
+    #endif
+
+    // the whole buffer changed
+    dev.changed(METADATA_SIZE + rBufSize);
+
+    return commit();
+
+  }
+
+
+  // class initializer
+  int begin(void) {
+  /* Class instance init
+   * Scan the ring buffer for a valid data structure. If yes,
+   * gather all relevant data for its management. If not,
+   * return an error code.
+   */
+
+    TRACE_OPERATION(TRACE_BEGIN);
+
+    int rc = beginStart();
+    while (rc == IN_PROGRESS)
+      rc = beginStep((size_t)-1);
+
+    return rc;
+
+  }
+
+
+  int beginStart(void) {
+  /* start a resumable begin, done in steps by beginStep, i.e. to feed a
+   * watchdog or to serve the network between steps. If a valid checkpoint
+   * exists, resume from it and return SUCCESS, otherwise prepare the scan
+   * of the ring buffer and return IN_PROGRESS. With sequence numbers or
+   * timestamps, IN_PROGRESS is returned also after a checkpoint resume:
+   * beginStep rebuilds their indexes. Until the begin completes, no other
+   * FIFO method must be called.
+   */
+
+    TRACE_OPERATION(TRACE_BEGIN);
+
+    // make the storage medium accessible up to the FIFO end
+    dev.begin((size_t)pRBufEnd);
+
+    // a streaming push or read open before is lost
+    streamSize = 0;
+    pChunk = NULL;
+
+    #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP)
+    pIndex = NULL;
+    #endif
+
+    // check for the expected format type
+    #ifdef FORMAT_TYPE
+    if (eeRead(pBotBlockOffset + BOT_OFFSET_SIZE) != FORMAT_TYPE)
+      return INVALID_FORMAT;
+    #endif
+
+    #ifdef FIFOEE_COALESCE
+    pFreeTail = NULL;
+    #endif
+
+    // if a valid checkpoint exists, scan only the blocks changed after it
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    if (!resumeCheckpoint()) {
+      #ifdef FIFOEE_SEQUENCE
+      resumeSequence(true);
+      #endif
+      #ifdef FIFOEE_TIMESTAMP
+      resumeTimestamps();
+      #endif
+      #ifdef FIFOEE_CURSORS
+      restartCursors();
+      #endif
+      #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP)
+      indexStart();
+      return IN_PROGRESS;
+      #else
+      return SUCCESS;
+      #endif
+    }
+    #endif
+
+    // scan the blocks sequence in the ring buffer for changes of status
+    // to find the position of pointers pPush, pPop, pRead.
+    size_t botBlockOffset = readBotOffset();
+    if (botBlockOffset >= rBufSize)
+      return INVALID_BLOCK_HEADER;
+    pBotBlock = pRBufStart + botBlockOffset;
+    blockSize = readHeader(pBotBlock);
+
+    // check for invalid header (0x00: used block cannot have zero size)
+    if (!blockHeader || blockSize > rBufSize)
+      return INVALID_BLOCK_HEADER;
+
+    // init pointers and control variables for an empty ring buffer
+    pBlock = pBotBlock;
+    pPush = pBlock;
+    pPop = pBlock;
+    pRead = pBlock;
+
+    // scan state: last block status, block sizes summation, used blocks
+    scanStatus = blockStatus;
+    scanSize = blockSize;
+    usedBlocks = blockStatus == USED_BLOCK;
+
+    return IN_PROGRESS;
+
+  }
+
+
+  int beginStep(size_t maxBlocks) {
+  /* go on with the begin started by beginStart, scanning up to maxBlocks
+   * blocks. After the scan, the sequence and time indexes are rebuilt in
+   * the same way, walking up to maxBlocks used blocks for each step.
+   * Return IN_PROGRESS if the scan or the rebuild is not completed,
+   * otherwise the begin result.
+   */
+
+    TRACE_OPERATION(TRACE_BEGIN);
+
+    #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP)
+    if (pIndex)
+      return indexStep(maxBlocks);
+    #endif
+
+    // scan blocks into ring buffer for change of status and block size,
+    // count used blocks
+    size_t scanned = 0;
+    for (; scanned < maxBlocks; scanned++) {
+
+      // point to next block
+      pBlock += blockSize;
+
+      // if end of block chain (reached the ring buffer end) ...
+      if (pBlock >= pRBufEnd) {
+	
+	// check if block linked list closes over itself: topmost block
+	// must link to bottommost block.
+	if (pBotBlock != pBlock - rBufSize)
+	  return UNCLOSED_BLOCK_LIST;
+
+        // check if block sizes summation == given ring buffer size
+	if (rBufSize != scanSize)
+	  return WRONG_RBUFFER_SIZE;
+
+	break;
+      }
+
+      // get next block status and check it for validity
+      blockSize = readHeader(pBlock);
+      if (!blockHeader || blockSize > rBufSize)
+        return INVALID_BLOCK_HEADER;
+
+      // accumulate block sizes
+      scanSize += blockSize;
+      if (blockStatus == USED_BLOCK)
+        usedBlocks++;
+
+      // go on untill there is a change of status
+      if (scanStatus == blockStatus)
+	continue;
+
+      // there is a change of status in block sequence, process it.
+      uint8_t oldStatusSaved = scanStatus;
+      scanStatus = blockStatus;
+      switch (oldStatusSaved) {
+
+	// previous blocks have free status: next block is the head of
+	// the FIFO queue.
+	case FREE_BLOCK:
+
+          pPop = pBlock;
+	  pRead = pBlock;
+	  continue;
+
+	// previous blocks have used status: next block must nave a free
+	// status and it is the tail of the FIFO queue.
+	case USED_BLOCK:
+
+	  pPush = pBlock;
+	  continue;
+      }
+    }
+
+    // scan not yet at the ring buffer end
+    if (pBlock < pRBufEnd)
+      return IN_PROGRESS;
+
+    #ifdef FIFOEE_SEQUENCE
+    resumeSequence(false);
+    #endif
+
+    #ifdef FIFOEE_TIMESTAMP
+    resumeTimestamps();
+    #endif
+
+    #ifdef FIFOEE_CURSORS
+    restartCursors();
+    #endif
+
+    // the checkpoint was missing or stale, take a new one
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    invalidateCheckpoint();
+    checkpoint();
+    #endif
+
+    #ifdef FIFOEE_CACHE
+    cacheFlush();
+    #endif
+
+    // rebuild the indexes with the steps left
+    #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP)
+    indexStart();
+    return indexStep(maxBlocks - scanned);
+    #else
+    return SUCCESS;
+    #endif
+
+  }
+ 
+
+  int push(uint8_t *data, size_t size) {
+  /* push data to EEPROM (write a new block)
+   */
+
+    TRACE_OPERATION(TRACE_PUSH);
+
+    if (!size || size > PUSH_DATA_SIZE_MAX)
+      return INVALID_DATA_SIZE;
+
+    // the data is stored LZ encoded, if it gets smaller
+    #ifdef FIFOEE_COMPRESS
+    size_t lzSize = compression ?
+      LZ_RAW_SIZE_SIZE + lzEncode(data,size,NULL,NULL) : size;
+    if (lzSize < size) {
+      if (int rc = makeRoom(blockSizeOf(lzSize)))
+        return rc;
+      writeCompressed(data,size,lzSize);
+      return pushDone();
+    }
+    #endif
+
+    // allocate ring buffer space for data plus block header
+    if (int rc = makeRoom(blockSizeOf(size)))
+      return rc;
+
+    // copy data and set block header
+    writeBlock(data,size);
+
+    return pushDone();
+
+  }
+
+
+  int pushBatch(const dataBlock *blocks,size_t count) {
+  /* push a sequence of data blocks with a single pass over the free block
+   * chain: the space for all blocks is reserved at once, then all headers
+   * and data are written in one sweep and at most one commit is requested.
+   * The batch is pushed all or nothing: if it does not fit, nothing is
+   * written and FIFO_FULL is returned, if a block has no data or is too
+   * big, nothing is written and INVALID_DATA_SIZE is returned.
+   * blocks: array of data pointer/size pairs.
+   * count: number of elements in blocks.
+   */
+
+    TRACE_OPERATION(TRACE_PUSH);
+
+    // nothing to do for an empty batch
+    if (!count)
+      return SUCCESS;
+
+    // allocate ring buffer space for all data plus block headers
+    size_t required = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (!blocks[i].size || blocks[i].size > PUSH_DATA_SIZE_MAX)
+        return INVALID_DATA_SIZE;
+      required += blockSizeOf(blocks[i].size);
+    }
+
+    if (int rc = makeRoom(required))
+      return rc;
+
+    // copy data and set block header of each block
+    for (size_t i = 0; i < count; i++)
+      writeBlock(blocks[i].data,blocks[i].size);
+
+    return pushDone();
+
+  }
+
+
+  int pushSpans(const dataBlock *spans,size_t count) {
+  /* push a single block with the data gathered from a sequence of spans,
+   * i.e. the spans of a block peeked from another FIFO, without copying
+   * them into a contiguous buffer.
+   * spans: array of data pointer/size pairs, parts of the block data.
+   * count: number of elements in spans.
+   */
+
+    TRACE_OPERATION(TRACE_PUSH);
+
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++)
+      size += spans[i].size;
+    if (!size || size > PUSH_DATA_SIZE_MAX)
+      return INVALID_DATA_SIZE;
+
+    // allocate ring buffer space for data plus block header
+    if (int rc = makeRoom(blockSizeOf(size)))
+      return rc;
+
+    // copy data and set block header
+    writeBlock(spans,count,size);
+
+    return pushDone();
+
+  }
+
+
+  int pushBegin(size_t maxSize) {
+  /* open a streaming push of a single block, with its data written in
+   * parts by pushWrite, i.e. as they are read from a sensor, without a RAM
+   * buffer for the whole block. The space for maxSize data bytes is
+   * reserved at once, in overwrite mode dropping the oldest blocks. The
+   * block is pushed by pushCommit, with the data written up to then, or
+   * dropped by pushAbort. Until then, no other push or compact can be done.
+   */
+
+    TRACE_OPERATION(TRACE_PUSH);
+
+    if (!maxSize || maxSize > PUSH_DATA_SIZE_MAX)
+      return INVALID_DATA_SIZE;
+
+    // allocate ring buffer space for the max data plus block header
+    size_t required = blockSizeOf(maxSize);
+    if (int rc = makeRoom(required))
+      return rc;
+
+    // the reserved space becomes a single free block, so the data written
+    // before pushCommit does not break the block chain at a power loss.
+    // As for a pushed block, a block wrapping at ring buffer end changes
+    // the bottom block.
+    if (freeBlockSize(pPush) != required) {
+      uint8_t *pNext = pPush + required;
+      if (pNext > pRBufEnd)
+        writeBotOffset(pNext - pRBufEnd);
+      uint8_t hSize = writeHeader(pPush,FREE_BLOCK,required);
+      if (pNext == pRBufEnd)
+        writeBotOffset(0);
+      #ifdef FIFOEE_SPSC
+      storeShared(pushedBytes,pushedBytes + hSize);
+      #else
+      dev.changed(hSize);
+      #endif
+    }
+
+    streamSize = required;
+    streamData = required - maxSize;
+    streamWritten = 0;
+
+    // the block gets the time of pushBegin. The sequence number, the
+    // timestamp and the codec are counted into the CRC before the data
+    #ifdef FIFOEE_TIMESTAMP
+    pushTime = readClock();
+    #endif
+    #ifdef FIFOEE_BLOCK_CRC
+    streamCrc = newBlockCrc(CODEC_RAW);
+    #endif
+
+    return SUCCESS;
+
+  }
+
+
+  int pushWrite(uint8_t *data,size_t size) {
+  /* write the given data after the data already written into the block
+   * of the open streaming push. The data is not visible until pushCommit.
+   */
+
+    TRACE_OPERATION(TRACE_PUSH);
+
+    if (!streamSize)
+      return PUSH_NOT_OPEN;
+
+    if (streamWritten + size > streamSize - streamData)
+      return INVALID_DATA_SIZE;
+
+    writeRing(wrap(pPush + streamData + streamWritten),data,size);
+    #ifdef FIFOEE_BLOCK_CRC
+    streamCrc = crcBlock(streamCrc,data,size);
+    #endif
+    streamWritten += size;
+
+    return SUCCESS;
+
+  }
+
+
+  int pushCommit(void) {
+  /* push the block of the open streaming push, with the data written so
+   * far, and close the streaming push. The reserved space not written
+   * becomes a free block. As for push, the block header is written last.
+   * With no data written, the streaming push stays open.
+   */
+
+    TRACE_OPERATION(TRACE_PUSH);
+
+    if (!streamSize)
+      return PUSH_NOT_OPEN;
+
+    if (!streamWritten)
+      return INVALID_DATA_SIZE;
+
+    // the residual reserved space becomes a new free block, ending at the
+    // bottom block set by pushBegin, if it wraps at ring buffer end
+    size_t newBlockSize = streamData + streamWritten;
+    if (newBlockSize < streamSize) {
+      writeHeader(wrap(pPush + newBlockSize),FREE_BLOCK,
+        streamSize - newBlockSize);
+    }
+
+    // sequence number, timestamp, CRC and codec before data
+    #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP) || \
+      defined(FIFOEE_BLOCK_CRC) || defined(FIFOEE_COMPRESS)
+    uint8_t *pData = wrap(pPush + streamData);
+    #ifdef FIFOEE_SEQUENCE
+    writeSequence(pData);
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    writeTimestamp(pData);
+    #endif
+    #ifdef FIFOEE_BLOCK_CRC
+    writeBlockCrc(pData,streamCrc);
+    #endif
+    #ifdef FIFOEE_COMPRESS
+    writeCodec(pData,CODEC_RAW);
+    #endif
+    #endif
+
+    // the header reserved for the max size is kept, also if the data
+    // turned out small enough for a one byte header
+    closeBlock(newBlockSize,
+      streamData - SEQUENCE_SIZE - TIMESTAMP_SIZE - BLOCK_CRC_SIZE -
+      CODEC_SIZE > 1);
+    streamSize = 0;
+
+    // a checkpoint taken while the streaming push was open has not
+    // counted its block
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    cpPushed += newBlockSize;
+    #endif
+
+    return pushDone();
+
+  }
+
+
+  int pushAbort(void) {
+  /* close the open streaming push without pushing its block: the reserved
+   * space is left as a single free block.
+   */
+
+    TRACE_OPERATION(TRACE_PUSH);
+
+    if (!streamSize)
+      return PUSH_NOT_OPEN;
+
+    streamSize = 0;
+
+    return pushDone();
+
+  }
+
+
+  int pop(uint8_t *data,size_t *size) {
+  /* pop out a block: copy data of the current pop block from the FIFO
+   * ring buffer to a given data buffer and mark the popped block in the
+   * FIFO ring buffer as "free", ready to be used to store another
+   * incoming block. The pop pointer in the ring buffer is moved to
+   * the next block.
+   */
+
+    TRACE_OPERATION(TRACE_POP);
+
+    // if ring buffer is empty
+    if (pPop == loadShared(pPush))
+      return FIFO_EMPTY;
+
+    // the block must be read by all the cursors
+    #ifdef FIFOEE_CURSORS
+    if (headUnread())
+      return UNREAD_BLOCK;
+    #endif
+
+    // copy data from ring buffer to given data buffer
+    pBlock = pPop;
+    if (int rc = readData(data,size))
+      return rc;
+
+    // mark block just read as deleted
+    releaseBlock();
+
+    return flushWrites();
+
+  }
+
+
+  int peek(dataBlock *spans) {
+  /* zero copy read of the block at the FIFO queue head: return the block
+   * data as one or two spans directly over the ring buffer memory, two if
+   * the block wraps at the ring buffer end. The block is not popped, see
+   * consume. Spans are valid until the block is popped or the FIFO is
+   * formatted: pushes never touch the block at the queue head.
+   * Available only with backends giving direct access to the medium,
+   * RAM or emulated EEPROM.
+   * spans: array of two spans, the second has zero size if not used.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    // if ring buffer is empty
+    if (pPop == loadShared(pPush))
+      return FIFO_EMPTY;
+
+    blockSize = readHeader(pPop);
+    #ifdef FIFOEE_COMPRESS
+    if (readCodec(pPop) == CODEC_LZ)
+      return COMPRESSED_BLOCK;
+    #endif
+    size_t dataSize = blockSize - headerSize;
+    uint8_t *pData = wrap(pPop + headerSize);
+
+    // first span from header to block end or to ring buffer end
+    spans[0].data = (uint8_t *)dev.dataPtr(pData);
+    spans[1].data = (uint8_t *)dev.dataPtr(pRBufStart);
+    if (pData + dataSize > pRBufEnd) {
+      spans[0].size = pRBufEnd - pData;
+      spans[1].size = dataSize - spans[0].size;
+    }
+    else {
+      spans[0].size = dataSize;
+      spans[1].size = 0;
+    }
+
+    // check the block CRC over the spans
+    #ifdef FIFOEE_BLOCK_CRC
+    uint16_t crc;
+    uint16_t blockCrc = readBlockCrc(pPop,&crc);
+    crc = crcBlock(crc,spans[0].data,spans[0].size);
+    if (crcBlock(crc,spans[1].data,spans[1].size) != blockCrc)
+      return INVALID_BLOCK_CRC;
+    #endif
+
+    return SUCCESS;
+
+  }
+
+
+  int consume(void) {
+  /* pop out the block at FIFO queue head without reading its data: only
+   * the block header is written to mark the block as free.
+   */
+
+    TRACE_OPERATION(TRACE_POP);
+
+    // if ring buffer is empty
+    if (pPop == loadShared(pPush))
+      return FIFO_EMPTY;
+
+    // the block must be read by all the cursors
+    #ifdef FIFOEE_CURSORS
+    if (headUnread())
+      return UNREAD_BLOCK;
+    #endif
+
+    // point to next block
+    blockSize = readHeader(pPop);
+    pBlock = wrap(pPop + blockSize);
+
+    // mark block as deleted
+    releaseBlock();
+
+    return flushWrites();
+
+  }
+
+
+  int popN(uint8_t *data,size_t *size,size_t *count,size_t *sizes = NULL) {
+  /* pop out up to count blocks from the FIFO queue head, with a single
+   * commit request at the end. The block data is copied one after the
+   * other into the given data buffer, popping stops at the first block
+   * that does not fit into the remaining buffer space.
+   * data: data buffer where to copy the popped out FIFO data.
+   * size: data buffer size, returns the total size of copied data.
+   * count: maximum number of blocks to pop, returns the number of popped
+   *   blocks.
+   * sizes: optional array of count elements, returns the data size of
+   *   each popped block.
+   */
+
+    TRACE_OPERATION(TRACE_POP);
+
+    // if ring buffer is empty
+    uint8_t *pTail = loadShared(pPush);
+    if (pPop == pTail) {
+      *size = 0;
+      *count = 0;
+      return FIFO_EMPTY;
+    }
+
+    // copy blocks data and mark blocks as deleted
+    int rc = SUCCESS;
+    size_t copied = 0;
+    size_t popped = 0;
+    while (popped < *count && pPop != pTail) {
+
+      #ifdef FIFOEE_CURSORS
+      if (headUnread()) {
+        rc = UNREAD_BLOCK;
+        break;
+      }
+      #endif
+
+      size_t dataSize = *size - copied;
+      pBlock = pPop;
+      if ((rc = readData(data + copied,&dataSize)))
+        break;
+
+      releaseBlock();
+      if (sizes)
+        sizes[popped] = dataSize;
+      copied += dataSize;
+      popped++;
+
+    }
+
+    if (popped)
+      rc = flushWrites();
+
+    *size = copied;
+    *count = popped;
+
+    return rc;
+
+  }
+
+
+  int popUntil(bool (*accept)(uint8_t *data,size_t size,void *context),
+    void *context,uint8_t *data,size_t size,size_t *count) {
+  /* pop out blocks from the FIFO queue head while the given callback
+   * accepts them, with a single commit request at the end. Each block is
+   * copied into the given data buffer and passed to the callback: if it
+   * returns true, the block is popped, otherwise popping stops and the
+   * block stays at the FIFO queue head. The callback must not call other
+   * FIFO methods.
+   * accept: callback called with block data, block data size and context.
+   * context: any user pointer, passed to accept.
+   * data: data buffer where to copy each block data.
+   * size: data buffer size.
+   * count: returns the number of popped blocks.
+   */
+
+    TRACE_OPERATION(TRACE_POP);
+
+    *count = 0;
+
+    // if ring buffer is empty
+    uint8_t *pTail = loadShared(pPush);
+    if (pPop == pTail)
+      return FIFO_EMPTY;
+
+    // copy each block data and mark accepted blocks as deleted
+    int rc = SUCCESS;
+    while (pPop != pTail) {
+
+      #ifdef FIFOEE_CURSORS
+      if (headUnread()) {
+        rc = UNREAD_BLOCK;
+        break;
+      }
+      #endif
+
+      size_t dataSize = size;
+      pBlock = pPop;
+      if ((rc = readData(data,&dataSize)))
+        break;
+
+      if (!accept(data,dataSize,context))
+        break;
+
+      releaseBlock();
+      (*count)++;
+
+    }
+
+    if (*count)
+      if (int flushRc = flushWrites())
+        rc = flushRc;
+
+    return rc;
+
+  }
+
+
+  int truncate(size_t count) {
+  /* drop the oldest count blocks, all the blocks if they are fewer,
+   * without reading their data and with a single commit request at the
+   * end. Only block headers are written: with coalescing, each run of
+   * dropped blocks, together with the free block before the head, if
+   * any, becomes a single free block writing only its first header, once.
+   * Dropping stops at a block not yet read by all the open cursors, see
+   * setCursorPolicy.
+   */
+
+    TRACE_OPERATION(TRACE_POP);
+
+    return dropBlocks(count,false);
+
+  }
+
+
+  int clear(void) {
+  /* drop all the blocks as truncate does, also the ones not yet read by
+   * the cursors. The FIFO is logically cleared writing at most one header
+   * for each block, instead of the whole ring buffer as format does. The
+   * read pointer and the open cursors are moved to the FIFO queue tail.
+   */
+
+    TRACE_OPERATION(TRACE_POP);
+
+    return dropBlocks((size_t)-1,true);
+
+  }
+
+
+  int read(uint8_t *data,size_t *size) {
+  /* read a block: copy data of the current read block from FIFO ring
+   * buffer to a given data buffer and mark the read block in the FIFO
+   * ring buffer as "read". The read pointer of the ring buffer is
+   * moved to the next block.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    // if ring buffer is empty
+    if (pRead == loadShared(pPush))
+      return FIFO_EMPTY;
+
+    // copy data from ring buffer to given data buffer
+    pBlock = pRead;
+    if (int rc = readData(data,size))
+      return rc;
+
+    // update read pointer
+    pRead = pBlock;
+
+    return SUCCESS;
+    
+  }
+ 
+
+  void restartRead(void) {
+  /* the read pointer is moved to the oldest data block, the FIFO queue head.
+   * WARNING: already read block status is NOT changed. So, at FIFO begin,
+   * all previous restarts are lost.
+   */
+
+    // restart reading
+    pRead = pPop;
+
+  }
+
+
+  int readOpen(size_t *size) {
+  /* open a streaming read of the current read block, whose data is then
+   * copied in parts by readChunk, i.e. to forward it to a small radio
+   * buffer without a buffer for the whole block. Set size to the block
+   * data size. Until readClose, the read pointer must not be moved and
+   * the block must not be popped.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    // if ring buffer is empty
+    if (pRead == loadShared(pPush))
+      return FIFO_EMPTY;
+
+    blockSize = readHeader(pRead);
+    #ifdef FIFOEE_COMPRESS
+    if (readCodec(pRead) == CODEC_LZ)
+      return COMPRESSED_BLOCK;
+    #endif
+    *size = blockSize - headerSize;
+    pChunk = wrap(pRead + headerSize);
+    chunkLeft = *size;
+    pChunkNext = wrap(pRead + blockSize);
+    #ifdef FIFOEE_BLOCK_CRC
+    chunkBlockCrc = readBlockCrc(pRead,&chunkCrc);
+    #endif
+
+    return SUCCESS;
+
+  }
+
+
+  int readChunk(uint8_t *data,size_t *size) {
+  /* copy the next part of the open read block, up to size bytes, to the
+   * given data buffer, the copy wraps at ring buffer end. Set size to the
+   * bytes copied, zero at the block end. With block CRC, the chunk ending
+   * the block returns INVALID_BLOCK_CRC if the block data does not match
+   * its CRC.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    if (!pChunk)
+      return READ_NOT_OPEN;
+
+    if (*size > chunkLeft)
+      *size = chunkLeft;
+    readRing(pChunk,data,*size);
+    pChunk = wrap(pChunk + *size);
+    chunkLeft -= *size;
+
+    #ifdef FIFOEE_BLOCK_CRC
+    chunkCrc = crcBlock(chunkCrc,data,*size);
+    if (*size && !chunkLeft && chunkCrc != chunkBlockCrc)
+      return INVALID_BLOCK_CRC;
+    #endif
+
+    return SUCCESS;
+
+  }
+
+
+  int readClose(void) {
+  /* close the streaming read and move the read pointer to the next block,
+   * also if the block data was not copied up to its end.
+   */
+
+    if (!pChunk)
+      return READ_NOT_OPEN;
+
+    pRead = pChunkNext;
+    pChunk = NULL;
+
+    return SUCCESS;
+
+  }
+
+
+  #ifdef FIFOEE_SEQUENCE
+  int seek(uint16_t seq) {
+  /* move the read pointer to the block with the given sequence number,
+   * the next read returns it. The scan starts from the nearest index
+   * entry, if still valid, otherwise from the FIFO queue head.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    // the block must be into the FIFO
+    uint16_t ahead = seq - headSeq;
+    if (ahead >= usedBlocks)
+      return INVALID_SEQUENCE;
+
+    // index entry at or before seq, valid if its block was not popped
+    // and if the entry was not reused by a more recent block
+    uint8_t *p = pPop;
+    uint16_t pSeq = headSeq;
+    uint16_t base = seq & ~(uint16_t)(FIFOEE_SEQUENCE_STRIDE - 1);
+    if ((uint16_t)(base - headSeq) <= ahead && (uint16_t)(tailSeq - base) <=
+      (uint32_t)FIFOEE_SEQUENCE_INDEX * FIFOEE_SEQUENCE_STRIDE) {
+      p = pRBufStart + seqIndex[base / FIFOEE_SEQUENCE_STRIDE &
+        (FIFOEE_SEQUENCE_INDEX - 1)];
+      pSeq = base;
+    }
+
+    // short scan up to the block
+    while (pSeq != seq) {
+      p = wrap(p + readHeader(p));
+      pSeq++;
+    }
+    pRead = p;
+
+    return SUCCESS;
+
+  }
+
+
+  uint16_t readSequence(void) {
+  /* sequence number of the block that the next read returns, or of the
+   * next pushed block if the read reached the FIFO queue tail
+   */
+
+    if (pRead == pPush)
+      return tailSeq;
+
+    return readSequence(pRead);
+
+  }
+
+
+  uint16_t headSequence(void) {
+  /* sequence number of the block at the FIFO queue head, the next popped
+   */
+
+    return headSeq;
+
+  }
+
+
+  uint16_t nextSequence(void) {
+  /* sequence number of the next pushed block
+   */
+
+    return tailSeq;
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_TIMESTAMP
+  int readSince(uint32_t time) {
+  /* move the read pointer to the oldest block with a timestamp not older
+   * than the given time, the next read returns it. If there is none, the
+   * read pointer is moved to the FIFO queue tail and FIFO_EMPTY is
+   * returned. The scan starts from the newest index entry older than the
+   * time, if any among the valid ones, otherwise from the FIFO queue head.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    uint16_t num;
+    pRead = seekTime(time,false,&num);
+
+    return pRead == pPush ? FIFO_EMPTY : SUCCESS;
+
+  }
+
+
+  int readRange(uint32_t time0,uint32_t time1,size_t *count) {
+  /* move the read pointer as readSince(time0) and set count to the number
+   * of blocks with a timestamp from time0 to time1, included, the next
+   * count reads return them. Return FIFO_EMPTY if there is none.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    uint16_t num0;
+    uint16_t num1;
+    pRead = seekTime(time0,false,&num0);
+    seekTime(time1,true,&num1);
+    *count = time1 < time0 ? 0 : (uint16_t)(num1 - num0);
+
+    return *count ? SUCCESS : FIFO_EMPTY;
+
+  }
+
+
+  int readTimestamp(uint32_t *time) {
+  /* set time to the timestamp of the block that the next read returns.
+   * Return FIFO_EMPTY if the read reached the FIFO queue tail.
+   */
+
+    if (pRead == pPush)
+      return FIFO_EMPTY;
+
+    uint8_t header;
+    uint8_t hSize;
+    readHeader(pRead,&header,&hSize);
+    *time = readTime(wrap(pRead + hSize + SEQUENCE_SIZE));
+
+    return SUCCESS;
+
+  }
+
+
+  void setClock(uint32_t (*aClock)(void)) {
+  /* set the function giving the timestamp of the pushed blocks, i.e. the
+   * seconds of a real time clock, NULL for millis (default). Timestamps
+   * must not decrease from a block to the next one, also across power
+   * cycles, or the time reads may skip blocks.
+   */
+
+    clockSource = aClock;
+
+  }
+  #endif
+
+
+  #ifndef FIFOEE_SPSC
+  int compact(void) {
+  /* rewrite the free blocks between the FIFO queue tail and head, all the
+   * blocks if the FIFO is empty, as the fewest free blocks of the maximum
+   * size, so the next pushes read and merge fewer headers. Each header is
+   * written after the header of the block it links to, so the block chain
+   * stays valid at any time. Blocks wrapping at the ring buffer end keep
+   * their bounds. Not available in SPSC mode, the free blocks are of the
+   * push side.
+   */
+
+    TRACE_OPERATION(TRACE_OTHER);
+
+    // block bounds change: the checkpoint is no more reliable
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    invalidateCheckpoint();
+    #endif
+
+    // compact the free blocks in runs not crossing the ring buffer end
+    uint8_t *pRun = pPush;
+    uint8_t *p = pPush;
+    uint8_t *pLast = NULL;
+    do {
+
+      uint8_t header;
+      uint8_t hSize;
+      uint8_t *pNext = p + readHeader(p,&header,&hSize);
+
+      // a block wrapping at the ring buffer end ends the run and is kept
+      if (pNext > pRBufEnd) {
+        compactRun(pRun,p);
+        pLast = p;
+        pRun = wrap(pNext);
+      }
+      else if (pNext == pRBufEnd) {
+        if (uint8_t *pRunLast = compactRun(pRun,pNext))
+          pLast = pRunLast;
+        pRun = pRBufStart;
+      }
+      p = wrap(pNext);
+
+    } while (p != pPop);
+    if (pRun != p)
+      if (uint8_t *pRunLast = compactRun(pRun,p))
+        pLast = pRunLast;
+
+    // the last free block of an empty FIFO holds the last sequence number
+    #ifdef FIFOEE_SEQUENCE
+    if (pPop == pPush && pLast)
+      writeSequence(pLast,tailSeq - 1);
+    #else
+    (void)pLast;
+    #endif
+
+    #ifdef FIFOEE_COALESCE
+    pFreeTail = NULL;
+    #endif
+
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    checkpoint();
+    #endif
+
+    return flushWrites();
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_CURSORS
+  int openCursor(uint8_t *cursor) {
+  /* open a read cursor, an independent read pointer starting at the FIFO
+   * queue head. Cursors are in RAM: at begin, all open cursors restart
+   * from the FIFO queue head.
+   * cursor: returns the number of the opened cursor.
+   */
+
+    for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+      if (!pCursor[i]) {
+        pCursor[i] = pPop;
+        *cursor = i;
+        return SUCCESS;
+      }
+
+    return NO_FREE_CURSOR;
+
+  }
+
+
+  void closeCursor(uint8_t cursor) {
+  /* close a read cursor: pops no more wait for it
+   */
+
+    if (cursor < FIFOEE_CURSORS)
+      pCursor[cursor] = NULL;
+
+  }
+
+
+  int read(uint8_t cursor,uint8_t *data,size_t *size) {
+  /* read a block at the given cursor: copy data of the cursor block from
+   * FIFO ring buffer to a given data buffer and move the cursor to the
+   * next block. Each cursor reads at its own pace, from the FIFO queue
+   * head toward the tail.
+   */
+
+    TRACE_OPERATION(TRACE_READ);
+
+    if (cursor >= FIFOEE_CURSORS || !pCursor[cursor])
+      return INVALID_CURSOR;
+
+    // if cursor reached the FIFO queue tail
+    if (pCursor[cursor] == loadShared(pPush))
+      return FIFO_EMPTY;
+
+    // copy data from ring buffer to given data buffer
+    pBlock = pCursor[cursor];
+    if (int rc = readData(data,size))
+      return rc;
+
+    // update cursor
+    pCursor[cursor] = pBlock;
+
+    return SUCCESS;
+
+  }
+
+
+  int restartRead(uint8_t cursor) {
+  /* move the given cursor to the oldest data block, the FIFO queue head
+   */
+
+    if (cursor >= FIFOEE_CURSORS || !pCursor[cursor])
+      return INVALID_CURSOR;
+
+    pCursor[cursor] = pPop;
+
+    return SUCCESS;
+
+  }
+
+
+  void setCursorPolicy(uint8_t policy) {
+  /* set what pops do with the blocks not yet read by all the open cursors:
+   * with CURSORS_HOLD (default) the pop of such a block returns
+   * UNREAD_BLOCK, with CURSORS_SKIP the block is popped and the cursors
+   * still before it move to the next block. Blocks dropped in overwrite
+   * mode always skip the cursors.
+   */
+
+    cursorMode = policy;
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_BLOCK_CRC
+  int verify(size_t *dropped = NULL) {
+  /* check the CRC of all the blocks into the FIFO, from the queue head,
+   * and truncate the queue at the first bad block: the bad block and all
+   * the following ones, i.e. left half written by a power cut during a
+   * push, are dropped marking them as free. Block data is read in chunks,
+   * without a data buffer. Meant for power up, after begin: in SPSC mode,
+   * call it before the producer starts.
+   * dropped: optional, returns the number of dropped blocks.
+   */
+
+    TRACE_OPERATION(TRACE_OTHER);
+
+    // find the first bad block
+    uint8_t *p = pPop;
+    while (p != pPush) {
+
+      blockSize = readHeader(p);
+      uint16_t crc;
+      uint16_t blockCrc = readBlockCrc(p,&crc);
+      uint8_t chunk[16];
+      for (size_t done = headerSize; done < blockSize;) {
+        size_t partSize = blockSize - done;
+        if (partSize > sizeof(chunk))
+          partSize = sizeof(chunk);
+        readRing(wrap(p + done),chunk,partSize);
+        crc = crcBlock(crc,chunk,partSize);
+        done += partSize;
+      }
+      if (crc != blockCrc)
+        break;
+
+      p = wrap(p + blockSize);
+    }
+
+    // drop the blocks from the bad one to the queue tail, moving the read
+    // pointers in the dropped blocks or at the old tail to the new tail
+    size_t bad = 0;
+    uint8_t *pTail = p;
+    uint8_t *pOldTail = pPush;
+    while (p != pOldTail) {
+
+      blockSize = readHeader(p);
+      eeWrite(p,FREE_BLOCK | (blockHeader & BLOCK_SIZE_BITS));
+      if (pRead == p)
+        pRead = pTail;
+      #ifdef FIFOEE_CURSORS
+      for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+        if (pCursor[i] == p)
+          pCursor[i] = pTail;
+      #endif
+      p = wrap(p + blockSize);
+      bad++;
+    }
+
+    if (dropped)
+      *dropped = bad;
+    if (!bad)
+      return SUCCESS;
+
+    if (pRead == pOldTail)
+      pRead = pTail;
+    #ifdef FIFOEE_CURSORS
+    for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+      if (pCursor[i] == pOldTail)
+        pCursor[i] = pTail;
+    #endif
+
+    storeShared(pPush,pTail);
+    addShared(usedBlocks,-(int)bad);
+    dev.changed(bad);
+
+    #ifdef FIFOEE_SEQUENCE
+    tailSeq -= bad;
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    tailStamp -= bad;
+    #endif
+
+    // the push pointer moved back, the checkpoint is stale
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    invalidateCheckpoint();
+    checkpoint();
+    #endif
+
+    if (int rc = flushWrites())
+      return rc;
+
+    return INVALID_BLOCK_CRC;
+
+  }
+  #endif
+
+
+  size_t bytesUsed(void) {
+  /* ring buffer bytes taken by used blocks, headers included. All blocks
+   * from pPop to pPush are used, so it is their distance.
+   */
+
+    uint8_t *pTail = loadShared(pPush);
+    uint8_t *pHead = loadShared(pPop);
+    return pTail >= pHead ? pTail - pHead : rBufSize - (pHead - pTail);
+
+  }
+
+
+  size_t bytesFree(void) {
+  /* ring buffer bytes taken by free blocks, headers included. A push of
+   * a block, header included, fits into the FIFO if it is smaller than
+   * this value: a free block is always left between FIFO tail and head.
+   */
+
+    return rBufSize - bytesUsed();
+
+  }
+
+
+  size_t blockCount(void) {
+  /* number of used blocks into FIFO
+   */
+
+    return loadShared(usedBlocks);
+
+  }
+
+
+  int flush(void) {
+  /* commit now all pending changes to EEPROM. On boards with a true
+   * EEPROM, changes are always already written at the end of each FIFO
+   * operation, so this does nothing.
+   */
+
+    collectPushChanges();
+    if (dev.pending())
+      return commit();
+
+    return SUCCESS;
+
+  }
+
+
+  int poll(void) {
+  /* commit pending changes to EEPROM if their commit deadline is passed.
+   * To be called periodically, i.e. from loop, to commit the last changes
+   * of a burst without waiting for other FIFO operations.
+   * In SPSC mode, commits are done only by the pop side: call poll from
+   * the pop side to commit pushed data.
+   */
+
+    collectPushChanges();
+    if (dev.commitDue())
+      return commit();
+
+    return SUCCESS;
+
+  }
+
+
+  bool pending(void) {
+  /* return true if there are changes not yet committed to EEPROM. In SPSC
+   * mode, call it from the pop side.
+   */
+
+    collectPushChanges();
+    return dev.pending();
+
+  }
+
+
+  #ifndef FIFOEE_SPSC
+  void setOverwrite(bool enable) {
+  /* enable or disable the overwrite mode: when the FIFO is full, a push
+   * drops the oldest blocks until the new data fits, instead of returning
+   * FIFO_FULL. Dropping a block costs only its header write. Not available
+   * in SPSC mode, the push side cannot drop blocks of the pop side.
+   */
+
+    overwrite = enable;
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_COMPRESS
+  void setCompression(bool enable) {
+  /* enable or disable the LZ compression of the data pushed by push, on
+   * by default. Blocks already pushed are read as stored, compressed or
+   * not.
+   */
+
+    compression = enable;
+
+  }
+  #endif
+
+
+  void setCommitThreshold(size_t maxDirtyBytes) {
+  /* commit as soon as the bytes changed by push and pop since the last
+   * commit reach the given value. Zero disables the threshold.
+   * Available only with emulated EEPROM.
+   */
+
+    dev.setCommitThreshold(maxDirtyBytes);
+
+  }
+
+
+  uint32_t commitCount(void) {
+  /* number of commits since FIFOEE object creation (boot).
+   * Available only with emulated EEPROM.
+   */
+
+    return dev.commitCount();
+
+  }
+
+
+  #ifdef FIFOEE_WEAR_REGIONS
+  const wearStats &wearStatistics(void) {
+  /* counters of the writes to the storage medium since object creation
+   * or since the last clear: all written bytes, commits, written bytes
+   * of each ring buffer region of regionSize bytes, from ring buffer start,
+   * and writes of each metadata byte, from FIFO buffer start.
+   */
+
+    return wear;
+
+  }
+
+
+  void clearWearStatistics(void) {
+  /* clear all wear counters
+   */
+
+    memset(&wear,0,sizeof(wear));
+    wear.regionSize = (rBufSize + FIFOEE_WEAR_REGIONS - 1) /
+      FIFOEE_WEAR_REGIONS;
+    if (!wear.regionSize)
+      wear.regionSize = 1;
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_TRACE
+  const traceStats &traceStatistics(uint8_t operation) {
+  /* counters of the given kind of operation, TRACE_PUSH ... TRACE_OTHER,
+   * since object creation or since the last clear: operations done, their
+   * duration, total and max, storage bytes read and written and block
+   * headers read.
+   */
+
+    return trace[operation];
+
+  }
+
+
+  void clearTraceStatistics(void) {
+  /* clear all trace counters
+   */
+
+    memset(trace,0,sizeof(trace));
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_CHECKPOINT_SLOTS
+  void checkpoint(void) {
+  /* save the current push and pop offsets and the number of used blocks
+   * into the next checkpoint slot,
+   * so the next begin does not need to scan the whole ring buffer. Slots
+   * are used in rotation to spread EEPROM wearing. Nothing is written if
+   * the FIFO pointers did not change since the last checkpoint.
+   * With emulated EEPROM this is done automatically before each commit.
+   */
+
+    size_t pushOffset = pPush - pRBufStart;
+    size_t popOffset = pPop - pRBufStart;
+    if (cpValid && pushOffset == cpPushOffset && popOffset == cpPopOffset)
+      return;
+
+    // fill slot data, sequence number last
+    cpSlot = (cpSlot + 1) % FIFOEE_CHECKPOINT_SLOTS;
+    cpSeq++;
+    uint8_t slot[CHECKPOINT_SLOT_SIZE] = { cpSeq,
+      (uint8_t)pushOffset,(uint8_t)(pushOffset >> 8),
+      (uint8_t)popOffset,(uint8_t)(popOffset >> 8),
+      (uint8_t)usedBlocks,(uint8_t)(usedBlocks >> 8) };
+    slot[CHECKPOINT_SLOT_SIZE - 1] = crc8(slot,CHECKPOINT_SLOT_SIZE - 1);
+
+    uint8_t *pSlot = pCheckpoint + cpSlot * CHECKPOINT_SLOT_SIZE;
+    for (int i = CHECKPOINT_SLOT_SIZE - 1; i >= 0; i--)
+      eeWrite(pSlot + i,slot[i]);
+
+    // the checkpoint stays reliable while pushes do not reach the old
+    // pop block, the free space at checkpoint time.
+    cpValid = true;
+    cpPushOffset = pushOffset;
+    cpPopOffset = popOffset;
+    cpFree = popOffset > pushOffset ? popOffset - pushOffset :
+      rBufSize - pushOffset + popOffset;
+    cpPushed = 0;
+
+    #ifdef FIFOEE_CACHE
+    cacheFlush();
+    #endif
+
+  }
+  #endif
+
+
+  private:
+
+  void init(uint8_t *aBuffer,size_t aBufSize) {
+  /* init control vars, common to all constructors
+   */
+
+    pBotBlockOffset = aBuffer;
+    rBufSize = aBufSize > METADATA_SIZE ? aBufSize - METADATA_SIZE : 0;
+    pRBufStart = aBuffer + METADATA_SIZE;
+    pRBufEnd = pRBufStart + rBufSize;
+
+    #ifdef FIFOEE_CACHE
+    for (uint8_t i = 0; i < FIFOEE_CACHE_PAGES; i++) {
+      cache[i].page = NULL;
+      cache[i].dirty = false;
+    }
+    #endif
+
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    pCheckpoint = aBuffer + BOT_OFFSET_SIZE + FORMAT_MARKER_SIZE;
+    cpSeq = 0;
+    cpSlot = FIFOEE_CHECKPOINT_SLOTS - 1;
+    cpValid = false;
+    #endif
+
+    #ifdef FIFOEE_SEGMENTS
+    segmentSize = rBufSize / FIFOEE_SEGMENTS;
+    if (!segmentSize)
+      segmentSize = 1;
+    #endif
+
+    #ifdef FIFOEE_WEAR_REGIONS
+    clearWearStatistics();
+    #endif
+
+    #ifdef FIFOEE_TRACE
+    clearTraceStatistics();
+    traceTop = NULL;
+    #endif
+
+    #ifdef FIFOEE_CURSORS
+    for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+      pCursor[i] = NULL;
+    #endif
+
+  }
+
+
+  void releaseBlock(void) {
+  /* mark the block at pPop, with header blockHeader and size blockSize,
+   * as free and move pPop to the next block, pointed by pBlock. Only the
+   * status bit is changed or, with coalescing, the block is merged into
+   * the free block before it, writing only the header of that block.
+   */
+
+    #ifdef FIFOEE_COALESCE
+    if (pFreeTail && pFreeTail + freeTailSize == pPop &&
+      freeTailSize + blockSize <= COALESCE_SIZE_MAX) {
+      freeTailSize += blockSize;
+      writeHeader(pFreeTail,FREE_BLOCK,freeTailSize);
+    }
+    else {
+      eeWrite(pPop,FREE_BLOCK | (blockHeader & BLOCK_SIZE_BITS));
+      pFreeTail = pPop;
+      freeTailSize = blockSize;
+    }
+    #else
+    eeWrite(pPop,FREE_BLOCK | (blockHeader & BLOCK_SIZE_BITS));
+    #endif
+    dev.changed(1);
+
+    movePop();
+
+  }
+
+
+  void movePop(void) {
+  /* move pPop to the next block, pointed by pBlock, with the read pointers
+   * at pPop, and count the block as popped. The block header is written
+   * by the caller.
+   */
+
+    // read pointer must be always at or before pop pointer
+    if (pRead == pPop)
+      pRead = pBlock;
+    #ifdef FIFOEE_CURSORS
+    for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+      if (pCursor[i] == pPop)
+        pCursor[i] = pBlock;
+    #endif
+
+    // move pop pointer to next block
+    storeShared(pPop,pBlock);
+    addShared(usedBlocks,-1);
+
+    #ifdef FIFOEE_SEQUENCE
+    headSeq++;
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    headStamp++;
+    #endif
+
+  }
+
+
+  int dropBlocks(size_t count,bool force) {
+  /* drop up to count blocks from the FIFO queue head, writing only their
+   * headers, see truncate. With coalescing, the header of the first block
+   * of a run is written when the run ends, with the size of the whole
+   * run: a single byte write, so a power cut leaves the run either used
+   * or free. If force is true, the blocks not yet read by the cursors are
+   * dropped too.
+   */
+
+    uint8_t *pTail = loadShared(pPush);
+    if (pPop == pTail)
+      return FIFO_EMPTY;
+
+    // the run starts with the free block before the head, if any
+    #ifdef FIFOEE_COALESCE
+    uint8_t *pRun = NULL;
+    uint8_t runHeader = FREE_BLOCK;
+    size_t runOldSize = 0;
+    size_t runSize = 0;
+    if (pFreeTail && pFreeTail + freeTailSize == pPop) {
+      pRun = pFreeTail;
+      runOldSize = runSize = freeTailSize;
+    }
+    #endif
+
+    int rc = SUCCESS;
+    size_t dropped = 0;
+    while (dropped < count && pPop != pTail) {
+
+      #ifdef FIFOEE_CURSORS
+      if (!force && headUnread()) {
+        rc = UNREAD_BLOCK;
+        break;
+      }
+      #else
+      (void)force;
+      #endif
+
+      blockSize = readHeader(pPop);
+      pBlock = wrap(pPop + blockSize);
+
+      // merge the block into the run, if it keeps a one byte header,
+      // otherwise start a new run from it
+      #ifdef FIFOEE_COALESCE
+      if (pRun && pRun + runSize == pPop &&
+        runSize + blockSize <= COALESCE_SIZE_MAX)
+        runSize += blockSize;
+      else {
+        freeRun(pRun,runHeader,runOldSize,runSize);
+        pRun = pPop;
+        runHeader = blockHeader;
+        runOldSize = runSize = blockSize;
+      }
+      #else
+      eeWrite(pPop,FREE_BLOCK | (blockHeader & BLOCK_SIZE_BITS));
+      dev.changed(1);
+      #endif
+
+      movePop();
+      dropped++;
+
+    }
+
+    #ifdef FIFOEE_COALESCE
+    freeRun(pRun,runHeader,runOldSize,runSize);
+    pFreeTail = pRun;
+    freeTailSize = runSize;
+    #endif
+
+    if (dropped)
+      rc = flushWrites();
+
+    return rc;
+
+  }
+
+
+  #ifdef FIFOEE_COALESCE
+  void freeRun(uint8_t *p,uint8_t header,size_t oldSize,size_t size) {
+  /* write the header of the run of dropped blocks starting at p, if any:
+   * a free block of the run size if the run grew from its first block of
+   * header and size oldSize, otherwise the first block marked as free, if
+   * it was used.
+   */
+
+    if (!p)
+      return;
+
+    if (size != oldSize)
+      writeHeader(p,FREE_BLOCK,size);
+    else if ((header & BLOCK_STATUS_BIT) == USED_BLOCK)
+      eeWrite(p,FREE_BLOCK | (header & BLOCK_SIZE_BITS));
+    else
+      return;
+    dev.changed(1);
+
+  }
+  #endif
+
+
+  int flushWrites(void) {
+  /* end of a FIFO write operation: take a segment checkpoint, write back
+   * the cache, if any, and commit the changes, if due. Return the commit
+   * result, COMMIT_FAILURE if the commit was due and failed.
+   */
+
+    #ifdef FIFOEE_SEGMENTS
+    if (!cpValid ||
+      segmentOf(pPush - pRBufStart) != segmentOf(cpPushOffset) ||
+      segmentOf(pPop - pRBufStart) != segmentOf(cpPopOffset))
+      checkpoint();
+    #endif
+
+    #ifdef FIFOEE_CACHE
+    cacheFlush();
+    #endif
+
+    collectPushChanges();
+    if (dev.commitDue())
+      return commit();
+
+    return SUCCESS;
+
+  }
+
+
+  int pushDone(void) {
+  /* end of a FIFO push, return the commit result. In SPSC mode, the push
+   * side does not commit: its changes are told to the backend by the pop
+   * side.
+   */
+
+    #ifdef FIFOEE_SPSC
+    return SUCCESS;
+    #else
+    return flushWrites();
+    #endif
+
+  }
+
+
+  void collectPushChanges(void) {
+  /* in SPSC mode, tell to the backend the changes made by the push side
+   * since the last call. To be called by the pop side only.
+   */
+
+    #ifdef FIFOEE_SPSC
+    size_t pushed = loadShared(pushedBytes);
+    if (pushed != pushedBytesSeen)
+      dev.changed(pushed - pushedBytesSeen);
+    pushedBytesSeen = pushed;
+    #endif
+
+  }
+
+
+  template <class T> static T loadShared(T &var) {
+  /* read a variable shared by push and pop sides. In SPSC mode, it is an
+   * atomic load with acquire ordering: with interrupts disabled on AVR and
+   * ESP8266, by an atomic builtin on the other boards.
+   */
+
+    #if defined(FIFOEE_SPSC) && defined(__AVR__)
+    T val;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      val = var;
+    }
+    return val;
+    #elif defined(FIFOEE_SPSC) && defined(ESP8266)
+    uint32_t savedPS = xt_rsil(15);
+    T val = var;
+    xt_wsr_ps(savedPS);
+    return val;
+    #elif defined(FIFOEE_SPSC)
+    return __atomic_load_n(&var,__ATOMIC_ACQUIRE);
+    #else
+    return var;
+    #endif
+
+  }
+
+
+  template <class T> static void storeShared(T &var,T val) {
+  /* write a variable shared by push and pop sides, publishing all the
+   * previous writes. In SPSC mode, it is an atomic store with release
+   * ordering.
+   */
+
+    #if defined(FIFOEE_SPSC) && defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      var = val;
+    }
+    #elif defined(FIFOEE_SPSC) && defined(ESP8266)
+    uint32_t savedPS = xt_rsil(15);
+    var = val;
+    xt_wsr_ps(savedPS);
+    #elif defined(FIFOEE_SPSC)
+    __atomic_store_n(&var,val,__ATOMIC_RELEASE);
+    #else
+    var = val;
+    #endif
+
+  }
+
+
+  static void addShared(size_t &var,int delta) {
+  /* add to a counter shared by push and pop sides. In SPSC mode, it is an
+   * atomic read modify write.
+   */
+
+    #if defined(FIFOEE_SPSC) && defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      var += delta;
+    }
+    #elif defined(FIFOEE_SPSC) && defined(ESP8266)
+    uint32_t savedPS = xt_rsil(15);
+    var += delta;
+    xt_wsr_ps(savedPS);
+    #elif defined(FIFOEE_SPSC)
+    __atomic_fetch_add(&var,(size_t)delta,__ATOMIC_ACQ_REL);
+    #else
+    var += delta;
+    #endif
+
+  }
+
+
+  int makeRoom(size_t required) {
+  /* allocate ring buffer space of the given size (bytes, headers
+   * included). In overwrite mode, if the FIFO is full, drop the oldest
+   * blocks in place, marking them as free, until the space is found.
+   * Space that cannot fit into the empty FIFO drops no block.
+   */
+
+    // no other push while a streaming push is open
+    if (streamSize)
+      return PUSH_OPEN;
+
+    int rc = allocate(required);
+
+    #ifndef FIFOEE_SPSC
+    if (overwrite && required < rBufSize)
+      while (rc == FIFO_FULL && pPop != pPush) {
+        blockSize = readHeader(pPop);
+        pBlock = wrap(pPop + blockSize);
+        releaseBlock();
+        rc = allocate(required);
+      }
+    #endif
+
+    return rc;
+
+  }
+
+
+  int allocate(size_t required) {
+  /* allocate a contiguous space of the given size (bytes, headers
+   * included) starting at the current push block. If current pPush block
+   * is smaller than the requested size, merge the following free blocks
+   * until the requested size is satisfied or exceeded. The residual space
+   * becomes a new free block. At least one free block is always kept
+   * between the FIFO queue tail and head. Merging stops at the head block,
+   * so the push side never touches a block owned by the pop side, even
+   * while it is being freed.
+   */
+
+    // current push block must be free
+    size_t freeSize = freeBlockSize(pPush);
+    if (!freeSize)
+      return PUSH_BLOCK_NOT_FREE;
+
+    // head block, none if FIFO is empty
+    uint8_t *pHead = loadShared(pPop);
+    if (pHead == pPush)
+      pHead = NULL;
+
+    // a checkpoint is no more reliable if pushes can overwrite the block
+    // header at the checkpoint pop offset: discard it before or, with
+    // segment checkpoints, replace it with a new one.
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    if (cpValid && cpPushed + required >= cpFree)
+      #ifdef FIFOEE_SEGMENTS
+      checkpoint();
+      #else
+      invalidateCheckpoint();
+      #endif
+    #endif
+    
+    // the free block before the head can be merged by the push
+    #ifdef FIFOEE_COALESCE
+    if (pFreeTail == pPush)
+      pFreeTail = NULL;
+    #endif
+
+    //// merge free blocks up to the required size
+    size_t blockSize = freeSize;
+
+    while (required > blockSize) {
+
+      uint8_t *pNext = wrap(pPush + blockSize);
+	
+      if (pNext == pPush || pNext == pHead) 
+        return FIFO_FULL;
+
+      #ifdef FIFOEE_COALESCE
+      if (pNext == pFreeTail)
+        pFreeTail = NULL;
+      #endif
+
+      size_t nextSize = freeBlockSize(pNext);
+
+      if (!nextSize)
+        return FIFO_FULL;
+
+      blockSize += nextSize;
+    }
+
+    //// manage 2 relevant cases of required size vs the allowable free
+    // block size space found above (blockSize).
+
+    // case #1: required size < free size, allocate required size and
+    // make a new free block to fill the residual space.
+    if (required < blockSize)
+      writeHeader(wrap(pPush + required),FREE_BLOCK,blockSize - required);
+
+    // case #2: required size == free size, if next block is free go on.
+    // Otherwise, return FIFO full.
+    else {
+
+      uint8_t *pNext = wrap(pPush + blockSize);
+
+      if (pNext == pPush || pNext == pHead)
+        return FIFO_FULL;
+
+      if (!freeBlockSize(pNext))
+        return FIFO_FULL;
+
+    }
+
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    cpPushed += required;
+    #endif
+
+    return SUCCESS;
+
+  }
+
+
+  void writeBlock(uint8_t *data,size_t size) {
+  /* copy given data to the block pointed by pPush, already allocated,
+   * set its header as used and move pPush to the next block.
+   */
+
+    dataBlock span = { data, size };
+    writeBlock(&span,1,size);
+
+  }
+
+
+  void writeBlock(const dataBlock *spans,size_t count,size_t size) {
+  /* copy the data of the given spans, size bytes in all, one after the
+   * other to the block pointed by pPush, already allocated, set its header
+   * as used and move pPush to the next block. Data is written before
+   * header, so a block becomes valid only when complete.
+   */
+
+    // copy given data to eeprom data block, after block header, sequence
+    // number, timestamp, CRC and codec
+    size_t newBlockSize = blockSizeOf(size);
+    uint8_t *pData = wrap(pPush + newBlockSize - size);
+    #ifdef FIFOEE_TIMESTAMP
+    pushTime = readClock();
+    #endif
+    #ifdef FIFOEE_BLOCK_CRC
+    uint16_t crc = newBlockCrc(CODEC_RAW);
+    #endif
+    #ifdef FIFOEE_SEQUENCE
+    writeSequence(pData);
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    writeTimestamp(pData);
+    #endif
+    #ifdef FIFOEE_COMPRESS
+    writeCodec(pData,CODEC_RAW);
+    #endif
+    for (size_t i = 0; i < count; i++) {
+      writeRing(pData,spans[i].data,spans[i].size);
+      #ifdef FIFOEE_BLOCK_CRC
+      crc = crcBlock(crc,spans[i].data,spans[i].size);
+      #endif
+      pData = wrap(pData + spans[i].size);
+    }
+
+    // CRC computed in the same pass as the data copy
+    #ifdef FIFOEE_BLOCK_CRC
+    writeBlockCrc(wrap(pPush + newBlockSize - size),crc);
+    #endif
+
+    closeBlock(newBlockSize);
+
+  }
+
+
+  #ifdef FIFOEE_COMPRESS
+  void writeCompressed(uint8_t *data,size_t size,size_t lzSize) {
+  /* LZ encode the given data, lzSize bytes once encoded (raw size
+   * included), into the block pointed by pPush, already allocated, set its
+   * header as used and move pPush to the next block. As for writeBlock,
+   * the encoded data is written before the header.
+   */
+
+    size_t newBlockSize = blockSizeOf(lzSize);
+    uint8_t *pData = wrap(pPush + newBlockSize - lzSize);
+    uint16_t crc = 0;
+    #ifdef FIFOEE_TIMESTAMP
+    pushTime = readClock();
+    #endif
+    #ifdef FIFOEE_BLOCK_CRC
+    crc = newBlockCrc(CODEC_LZ);
+    #endif
+    #ifdef FIFOEE_SEQUENCE
+    writeSequence(pData);
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    writeTimestamp(pData);
+    #endif
+    writeCodec(pData,CODEC_LZ);
+
+    // raw data size, then the tokens, CRC computed while writing them
+    uint8_t rawSize[2] = { (uint8_t)size,(uint8_t)(size >> 8) };
+    uint8_t *pOut = pData;
+    lzWrite(&pOut,rawSize,LZ_RAW_SIZE_SIZE,&crc);
+    lzEncode(data,size,pOut,&crc);
+    #ifdef FIFOEE_BLOCK_CRC
+    writeBlockCrc(pData,crc);
+    #endif
+
+    closeBlock(newBlockSize);
+
+  }
+
+
+  size_t lzEncode(const uint8_t *data,size_t size,uint8_t *pOut,
+    uint16_t *crc) {
+  /* LZ encode the given data, taking at each position the longest match
+   * into the previous LZ_WINDOW data bytes. If pOut is not NULL, write the
+   * tokens to the ring buffer from pOut, updating crc, otherwise only
+   * count them. Return the size of the tokens.
+   */
+
+    size_t lzSize = 0;
+    size_t literal = 0;         // start of the pending literal run
+    for (size_t i = 0;; ) {
+
+      // longest match ending before i
+      size_t matchSize = 0;
+      size_t offset = 0;
+      for (size_t back = 1; back <= LZ_WINDOW && back <= i; back++) {
+        size_t n = 0;
+        while (n < LZ_MATCH_MAX && i + n < size &&
+          data[i + n - back] == data[i + n])
+          n++;
+        if (n > matchSize) {
+          matchSize = n;
+          offset = back;
+          if (n == LZ_MATCH_MAX)
+            break;
+        }
+      }
+      bool match = matchSize > 2 ||
+        (matchSize == 2 && offset <= LZ_SHORT_OFFSET_MAX);
+
+      // literal run ends at a match, at its max size or at data end
+      if (i > literal &&
+        (match || i - literal == LZ_LITERAL_MAX || i == size)) {
+        uint8_t token = i - literal - 1;
+        lzSize += lzWrite(&pOut,&token,1,crc);
+        lzSize += lzWrite(&pOut,data + literal,i - literal,crc);
+        literal = i;
+      }
+      if (i == size)
+        break;
+
+      if (!match) {
+        i++;
+        continue;
+      }
+
+      // short match token or long match token and offset
+      uint8_t token[2];
+      if (matchSize <= LZ_SHORT_SIZE_MAX && offset <= LZ_SHORT_OFFSET_MAX) {
+        token[0] = LZ_MATCH | (matchSize - 2) << 4 | (offset - 1);
+        lzSize += lzWrite(&pOut,token,1,crc);
+      }
+      else {
+        token[0] = LZ_MATCH | LZ_LONG | (matchSize - 3);
+        token[1] = offset - 1;
+        lzSize += lzWrite(&pOut,token,2,crc);
+      }
+      i += matchSize;
+      literal = i;
+    }
+
+    return lzSize;
+
+  }
+
+
+  size_t lzWrite(uint8_t **pOut,const uint8_t *bytes,size_t size,
+    uint16_t *crc) {
+  /* write the given bytes to the ring buffer at *pOut, if not NULL, and
+   * move *pOut after them, updating crc. Return size.
+   */
+
+    if (*pOut) {
+      writeRing(*pOut,bytes,size);
+      *pOut = wrap(*pOut + size);
+      #ifdef FIFOEE_BLOCK_CRC
+      *crc = crcBlock(*crc,bytes,size);
+      #endif
+    }
+
+    return size;
+
+  }
+
+
+  void lzRead(uint8_t **pIn,uint8_t *bytes,size_t size,uint16_t *crc) {
+  /* read size bytes from the ring buffer at *pIn and move *pIn after them,
+   * updating crc
+   */
+
+    readRing(*pIn,bytes,size);
+    *pIn = wrap(*pIn + size);
+    #ifdef FIFOEE_BLOCK_CRC
+    *crc = crcBlock(*crc,bytes,size);
+    #endif
+
+  }
+
+
+  int readCompressed(uint8_t *data,size_t *size) {
+  /* decode the LZ compressed block pointed by pBlock, just read by
+   * readHeader, directly from the ring buffer to the given data buffer:
+   * matches copy the data already decoded. Data buffer size and block CRC
+   * are checked as by readData, a corrupted token sequence returns
+   * INVALID_BLOCK_HEADER.
+   */
+
+    uint8_t *pIn = wrap(pBlock + headerSize);
+    size_t inSize = blockSize - headerSize;
+    uint16_t crc = 0;
+    #ifdef FIFOEE_BLOCK_CRC
+    uint16_t blockCrc = readBlockCrc(pBlock,&crc);
+    #endif
+
+    // raw data size
+    if (inSize < LZ_RAW_SIZE_SIZE)
+      return INVALID_BLOCK_HEADER;
+    uint8_t rawBytes[2] = { 0,0 };
+    lzRead(&pIn,rawBytes,LZ_RAW_SIZE_SIZE,&crc);
+    inSize -= LZ_RAW_SIZE_SIZE;
+    size_t rawSize = rawBytes[0] | (size_t)rawBytes[1] << 8;
+    if (rawSize > *size)
+      return DATA_BUFFER_SMALL;
+
+    size_t done = 0;
+    while (inSize) {
+
+      uint8_t token;
+      lzRead(&pIn,&token,1,&crc);
+      inSize--;
+
+      // literal run
+      if (!(token & LZ_MATCH)) {
+        size_t n = token + 1;
+        if (n > inSize || done + n > rawSize)
+          return INVALID_BLOCK_HEADER;
+        lzRead(&pIn,data + done,n,&crc);
+        inSize -= n;
+        done += n;
+        continue;
+      }
+
+      // short match or long match with its offset byte
+      size_t n;
+      size_t offset;
+      if (!(token & LZ_LONG)) {
+        n = (token >> 4 & 0x03) + 2;
+        offset = (token & 0x0f) + 1;
+      }
+      else {
+        if (!inSize)
+          return INVALID_BLOCK_HEADER;
+        uint8_t offsetByte;
+        lzRead(&pIn,&offsetByte,1,&crc);
+        inSize--;
+        n = (token & 0x3f) + 3;
+        offset = offsetByte + 1;
+      }
+      if (offset > done || done + n > rawSize)
+        return INVALID_BLOCK_HEADER;
+      for (; n; n--, done++)
+        data[done] = data[done - offset];
+    }
+    if (done != rawSize)
+      return INVALID_BLOCK_HEADER;
+
+    #ifdef FIFOEE_BLOCK_CRC
+    if (crc != blockCrc)
+      return INVALID_BLOCK_CRC;
+    #endif
+
+    *size = rawSize;
+    pBlock = wrap(pBlock + blockSize);
+
+    return SUCCESS;
+
+  }
+
+
+  uint8_t readCodec(uint8_t *p) {
+  /* return the codec of the used block pointed by p, just read by
+   * readHeader
+   */
+
+    return eeRead(wrap(p + headerSize - CODEC_SIZE));
+
+  }
+
+
+  void writeCodec(uint8_t *pData,uint8_t codec) {
+  /* write the codec of the block pointed by pPush, whose data starts at
+   * pData
+   */
+
+    eeWrite(wrap(pData + rBufSize - CODEC_SIZE),codec);
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_SEQUENCE
+  void writeSequence(uint8_t *pData) {
+  /* write the tail sequence number into the block pointed by pPush, whose
+   * data starts at pData, index the block and count it.
+   */
+
+    uint8_t seq[SEQUENCE_SIZE] = { (uint8_t)tailSeq,(uint8_t)(tailSeq >> 8) };
+    writeRing(wrap(pData + rBufSize - CODEC_SIZE - BLOCK_CRC_SIZE -
+      TIMESTAMP_SIZE - SEQUENCE_SIZE),seq,SEQUENCE_SIZE);
+    if (!(tailSeq & (FIFOEE_SEQUENCE_STRIDE - 1)))
+      seqIndex[tailSeq / FIFOEE_SEQUENCE_STRIDE &
+        (FIFOEE_SEQUENCE_INDEX - 1)] = pPush - pRBufStart;
+    tailSeq++;
+
+  }
+  #endif
+
+
+  void closeBlock(size_t newBlockSize,bool extended = false) {
+  /* set the header of the block pointed by pPush, with its data already
+   * written, as used and move pPush to the next block. An extended header
+   * is forced by extended.
+   */
+
+    // if the block is splitted (block wraps at FIFO buffer end back to start)
+    // update offset of bottom block
+    uint8_t *pNext = pPush + newBlockSize;
+    if (pNext > pRBufEnd)
+      writeBotOffset(pNext - pRBufEnd);
+
+    // set size and status for copied data block
+    writeHeader(pPush,USED_BLOCK,newBlockSize,extended);
+
+    // update push pointer to next block and bottommost block offset
+    // from pRBufStart 
+    if (pNext == pRBufEnd)
+      writeBotOffset(0);
+    addShared(usedBlocks,1);
+    storeShared(pPush,wrap(pNext));
+
+    #ifdef FIFOEE_SPSC
+    storeShared(pushedBytes,pushedBytes + newBlockSize);
+    #else
+    dev.changed(newBlockSize);
+    #endif
+
+  }
+
+
+  int readData(uint8_t *data,size_t *size) {
+  /* copy all data of block pointed by pBlock from the FIFO ring buffer to
+   * the given data buffer. If data block is splitted into a part at ring
+   * buffer top and what remains at buffer bottom, copy both as if they
+   * were a single block. If the data buffer size is too small for data
+   * block size, do not copy it and return a proper error code. Otherwise,
+   * return success (0). Also return the size of copied data. The pBlock
+   * pointer is set to point to the next block.
+   */
+
+    // check for sufficient data size
+    blockSize = readHeader(pBlock);
+    #ifdef FIFOEE_COMPRESS
+    if (readCodec(pBlock) == CODEC_LZ)
+      return readCompressed(data,size);
+    #endif
+    size_t dataSize = blockSize - headerSize;
+    if (dataSize > *size)
+      return DATA_BUFFER_SMALL;
+
+    // copy data from eeprom to the given data buffer.
+    *size = dataSize;
+    readRing(wrap(pBlock + headerSize),data,dataSize);
+
+    // check the block CRC over the copied data
+    #ifdef FIFOEE_BLOCK_CRC
+    uint16_t crc;
+    uint16_t blockCrc = readBlockCrc(pBlock,&crc);
+    if (crcBlock(crc,data,dataSize) != blockCrc)
+      return INVALID_BLOCK_CRC;
+    #endif
+
+    // next block pointer
+    pBlock = wrap(pBlock + blockSize);
+
+    return SUCCESS;
+    
+  }
+
+
+  uint8_t *wrap(uint8_t *p) {
+  /* wrap a pointer beyond ring buffer end back to ring buffer start
+   */
+
+    while (p >= pRBufEnd)
+      p -= rBufSize;
+
+    return p;
+
+  }
+
+
+  static size_t blockSizeOf(size_t dataSize) {
+  /* size of a used block (header, sequence number, timestamp, CRC and
+   * codec included) with the given data size
+   */
+
+    dataSize += SEQUENCE_SIZE + TIMESTAMP_SIZE + BLOCK_CRC_SIZE + CODEC_SIZE;
+
+    #ifdef FIFOEE_EXTENDED_SIZE
+    if (dataSize >= EXTENDED_SIZE_CODE)
+      return dataSize + EXTENDED_HEADER_SIZE;
+    #endif
+
+    return dataSize + 1;
+
+  }
+
+
+  size_t readHeader(uint8_t *p) {
+  /* read the header of the block pointed by p, set blockHeader,
+   * blockStatus and headerSize. Return the block size, header included.
+   * The sequence number, the timestamp, the CRC and the codec of used
+   * blocks are counted into headerSize, so the block data starts just
+   * after headerSize bytes.
+   */
+
+    size_t size = readHeader(p,&blockHeader,&headerSize);
+    blockStatus = blockHeader & BLOCK_STATUS_BIT;
+    #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP) || \
+      defined(FIFOEE_BLOCK_CRC) || defined(FIFOEE_COMPRESS)
+    if (blockStatus == USED_BLOCK)
+      headerSize += SEQUENCE_SIZE + TIMESTAMP_SIZE + BLOCK_CRC_SIZE +
+        CODEC_SIZE;
+    #endif
+
+    return size;
+
+  }
+
+
+  size_t readHeader(uint8_t *p,uint8_t *header,uint8_t *hSize) {
+  /* read the header of the block pointed by p into the given vars, header
+   * first byte and header size. Return the block size, header included.
+   */
+
+    #ifdef FIFOEE_TRACE
+    if (traceTop)
+      trace[traceTop->op].headers++;
+    #endif
+
+    *header = eeRead(p);
+    *hSize = 1;
+    size_t dataSize = *header & BLOCK_SIZE_BITS;
+
+    #ifdef FIFOEE_EXTENDED_SIZE
+    if (dataSize == EXTENDED_SIZE_CODE) {
+      *hSize = EXTENDED_HEADER_SIZE;
+      dataSize = (size_t)eeRead(wrap(p + 1)) << 8 | eeRead(wrap(p + 2));
+    }
+    #endif
+
+    return dataSize + *hSize;
+
+  }
+
+
+  size_t freeBlockSize(uint8_t *p) {
+  /* size of the block pointed by p, header included, if it is free, zero
+   * if it is used. No control var is changed, so the push side does not
+   * touch the block vars of the pop side.
+   */
+
+    uint8_t header;
+    uint8_t hSize;
+    size_t size = readHeader(p,&header,&hSize);
+
+    return (header & BLOCK_STATUS_BIT) == FREE_BLOCK ? size : 0;
+
+  }
+
+
+  #ifndef FIFOEE_SPSC
+  uint8_t *compactRun(uint8_t *p,uint8_t *pEnd) {
+  /* rewrite the free blocks from p to pEnd, not wrapping at the ring
+   * buffer end, as free blocks of the maximum size. A block grows writing
+   * first the header of its next block, if it falls into an old block,
+   * then its own header with a single byte change: with extended headers,
+   * a one byte header becomes extended only over its own data bytes and
+   * an extended header grows changing its msb or its lsb, in steps.
+   * Return the last block of the run.
+   */
+
+    uint8_t *pLast = NULL;
+    while (p < pEnd) {
+
+      uint8_t header;
+      uint8_t hSize;
+      size_t oldSize = readHeader(p,&header,&hSize);
+
+      for (;;) {
+
+        size_t size = pEnd - p;
+        #ifdef FIFOEE_EXTENDED_SIZE
+        if (size > EXTENDED_BLOCK_SIZE_MAX)
+          size = EXTENDED_BLOCK_SIZE_MAX;
+        if (hSize == EXTENDED_HEADER_SIZE) {
+          size_t dataSize = oldSize - EXTENDED_HEADER_SIZE;
+          size_t dataMax = size - EXTENDED_HEADER_SIZE;
+          size_t newSize = (dataMax & ~(size_t)0xff) | (dataSize & 0xff);
+          if (newSize > dataMax)
+            newSize -= 0x100;
+          if (newSize <= dataSize) {
+            newSize = dataSize | 0xff;
+            if (newSize > dataMax)
+              newSize = dataMax;
+          }
+          size = newSize + EXTENDED_HEADER_SIZE;
+        }
+        else if (oldSize < EXTENDED_HEADER_SIZE && size > EXTENDED_SIZE_CODE)
+          size = EXTENDED_SIZE_CODE;
+        #else
+        if (size > BLOCK_SIZE_MAX)
+          size = BLOCK_SIZE_MAX;
+        #endif
+
+        // block already of the maximum size
+        if (size <= oldSize)
+          break;
+
+        // find the old block holding the next block, split it there
+        uint8_t *pNext = p + size;
+        for (uint8_t *q = p + oldSize; q < pNext;) {
+          uint8_t *qNext = q + readHeader(q,&header,&hSize);
+          if (qNext > pNext) {
+            writeHeader(pNext,FREE_BLOCK,qNext - pNext);
+            dev.changed(1);
+          }
+          q = qNext;
+        }
+
+        writeHeader(p,FREE_BLOCK,size);
+        dev.changed(1);
+        oldSize = size;
+        #ifdef FIFOEE_EXTENDED_SIZE
+        hSize = size > EXTENDED_SIZE_CODE ? EXTENDED_HEADER_SIZE : 1;
+        #endif
+      }
+
+      pLast = p;
+      p += oldSize;
+    }
+
+    return pLast;
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_CURSORS
+  void restartCursors(void) {
+  /* move all the open cursors to the FIFO queue head
+   */
+
+    for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+      if (pCursor[i])
+        pCursor[i] = pPop;
+
+  }
+
+
+  bool headUnread(void) {
+  /* true if the pop must wait for a cursor: the block at the FIFO queue
+   * head is not yet read by an open cursor. Cursors are never before the
+   * head, so only a cursor at the head did not read it.
+   */
+
+    if (cursorMode == CURSORS_SKIP)
+      return false;
+
+    for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+      if (pCursor[i] == pPop)
+        return true;
+
+    return false;
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_BLOCK_CRC
+  static uint16_t crcBlock(uint16_t crc,const uint8_t *data,size_t size) {
+  /* update the block CRC with the given data: CRC-8, polynomial 0x07, or
+   * CRC-16, polynomial 0x1021, as FIFOEE_BLOCK_CRC
+   */
+
+    while (size--) {
+      #if FIFOEE_BLOCK_CRC == 8
+      crc ^= *data++;
+      for (uint8_t i = 0; i < 8; i++)
+        crc = crc & 0x80 ? (crc << 1 ^ 0x07) & 0xff : crc << 1 & 0xff;
+      #else
+      crc ^= (uint16_t)*data++ << 8;
+      for (uint8_t i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+      #endif
+    }
+
+    return crc;
+
+  }
+
+
+  uint16_t readBlockCrc(uint8_t *p,uint16_t *crc) {
+  /* return the CRC stored into the used block pointed by p, just read by
+   * readHeader, and set crc to the CRC of its sequence number, timestamp
+   * and codec, if any, ready to be updated with the block data
+   */
+
+    const uint8_t crcAt = SEQUENCE_SIZE + TIMESTAMP_SIZE;
+    uint8_t meta[crcAt + BLOCK_CRC_SIZE + CODEC_SIZE];
+    readRing(wrap(p + headerSize - sizeof(meta)),meta,sizeof(meta));
+    *crc = crcBlock(BLOCK_CRC_INIT,meta,crcAt);
+    *crc = crcBlock(*crc,meta + crcAt + BLOCK_CRC_SIZE,CODEC_SIZE);
+
+    #if FIFOEE_BLOCK_CRC == 8
+    return meta[crcAt];
+    #else
+    return meta[crcAt] | (uint16_t)meta[crcAt + 1] << 8;
+    #endif
+
+  }
+
+
+  uint16_t newBlockCrc(uint8_t codec) {
+  /* return the CRC of the sequence number and of the timestamp of the
+   * next pushed block, if any, and of the given codec, if any, ready to be
+   * updated with the block data
+   */
+
+    uint16_t crc = BLOCK_CRC_INIT;
+    #ifdef FIFOEE_SEQUENCE
+    uint8_t seq[SEQUENCE_SIZE] = { (uint8_t)tailSeq,(uint8_t)(tailSeq >> 8) };
+    crc = crcBlock(crc,seq,SEQUENCE_SIZE);
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    uint8_t time[TIMESTAMP_SIZE] = { (uint8_t)pushTime,
+      (uint8_t)(pushTime >> 8),(uint8_t)(pushTime >> 16),
+      (uint8_t)(pushTime >> 24) };
+    crc = crcBlock(crc,time,TIMESTAMP_SIZE);
+    #endif
+    #ifdef FIFOEE_COMPRESS
+    crc = crcBlock(crc,&codec,CODEC_SIZE);
+    #else
+    (void)codec;
+    #endif
+
+    return crc;
+
+  }
+
+
+  void writeBlockCrc(uint8_t *pData,uint16_t crc) {
+  /* write the given CRC into the block pointed by pPush, whose data
+   * starts at pData
+   */
+
+    uint8_t crcBytes[2] = { (uint8_t)crc,(uint8_t)(crc >> 8) };
+    writeRing(wrap(pData + rBufSize - CODEC_SIZE - BLOCK_CRC_SIZE),crcBytes,
+      BLOCK_CRC_SIZE);
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_SEQUENCE
+  uint16_t readSequence(uint8_t *p) {
+  /* read the sequence number of the block pointed by p
+   */
+
+    uint8_t header;
+    uint8_t hSize;
+    readHeader(p,&header,&hSize);
+    uint8_t seq[SEQUENCE_SIZE];
+    readRing(wrap(p + hSize),seq,SEQUENCE_SIZE);
+
+    return seq[0] | (uint16_t)seq[1] << 8;
+
+  }
+
+
+  void writeSequence(uint8_t *p,uint16_t seqNum) {
+  /* write the sequence number of the block pointed by p, if the block
+   * has room for it
+   */
+
+    uint8_t header;
+    uint8_t hSize;
+    if (readHeader(p,&header,&hSize) < (size_t)(hSize + SEQUENCE_SIZE))
+      return;
+    uint8_t seq[SEQUENCE_SIZE] = { (uint8_t)seqNum,(uint8_t)(seqNum >> 8) };
+    writeRing(wrap(p + hSize),seq,SEQUENCE_SIZE);
+
+  }
+
+
+  void resumeSequence(bool pushKnown) {
+  /* restore the sequence numbers at begin: from the FIFO queue head block
+   * or, if the FIFO is empty, from the block before the push block, the
+   * last pushed one, still holding its sequence number. The push block of
+   * an empty FIFO is known only from a checkpoint, without it numbering
+   * restarts from zero. The seek index is rebuilt by indexStep.
+   * pushKnown: true if pPush was restored from a checkpoint.
+   */
+
+    if (usedBlocks)
+      headSeq = readSequence(pPop);
+    else if (!pushKnown)
+      headSeq = 0;
+    else {
+
+      // walk the block chain up to the block before the push block
+      uint8_t *p = pRBufStart + readBotOffset();
+      uint8_t header;
+      uint8_t hSize;
+      for (size_t walked = 0; walked < rBufSize;) {
+        size_t size = readHeader(p,&header,&hSize);
+        uint8_t *pNext = wrap(p + size);
+        walked += size;
+        if (pNext == pPush)
+          break;
+        p = pNext;
+      }
+      headSeq =
+        readHeader(p,&header,&hSize) >= (size_t)(hSize + SEQUENCE_SIZE) ?
+        readSequence(p) + 1 : 0;
+    }
+    tailSeq = headSeq + usedBlocks;
+
+  }
+  #endif
+
+
+  #ifdef FIFOEE_TIMESTAMP
+  uint32_t readClock(void) {
+  /* timestamp for a block pushed now
+   */
+
+    return clockSource ? clockSource() : millis();
+
+  }
+
+
+  uint32_t readTime(uint8_t *p) {
+  /* read the timestamp pointed by p, lsb first
+   */
+
+    uint8_t time[TIMESTAMP_SIZE];
+    readRing(p,time,TIMESTAMP_SIZE);
+
+    return time[0] | (uint32_t)time[1] << 8 | (uint32_t)time[2] << 16 |
+      (uint32_t)time[3] << 24;
+
+  }
+
+
+  void writeTimestamp(uint8_t *pData) {
+  /* write pushTime into the block pointed by pPush, whose data starts at
+   * pData, index the block and count it.
+   */
+
+    uint8_t time[TIMESTAMP_SIZE] = { (uint8_t)pushTime,
+      (uint8_t)(pushTime >> 8),(uint8_t)(pushTime >> 16),
+      (uint8_t)(pushTime >> 24) };
+    writeRing(wrap(pData + rBufSize - CODEC_SIZE - BLOCK_CRC_SIZE -
+      TIMESTAMP_SIZE),time,TIMESTAMP_SIZE);
+    indexTime(tailStamp,pPush,pushTime);
+    tailStamp++;
+
+  }
+
+
+  void indexTime(uint16_t num,uint8_t *p,uint32_t time) {
+  /* if the block number num is at an index stride, store into the time
+   * index the given block pointer and timestamp
+   */
+
+    if (num & (FIFOEE_TIMESTAMP_STRIDE - 1))
+      return;
+
+    uint8_t entry = num / FIFOEE_TIMESTAMP_STRIDE &
+      (FIFOEE_TIMESTAMP_INDEX - 1);
+    timeOffsets[entry] = p - pRBufStart;
+    timeIndex[entry] = time;
+
+  }
+
+
+  void resumeTimestamps(void) {
+  /* restore the block numbering of the time index at begin: the blocks
+   * are numbered from zero at the FIFO queue head. The time index is
+   * rebuilt by indexStep.
+   */
+
+    headStamp = 0;
+    tailStamp = usedBlocks;
+
+  }
+
+
+  uint8_t *seekTime(uint32_t time,bool after,uint16_t *num) {
+  /* return the oldest used block with a timestamp not older than the given
+   * time or, if after is true, newer than it, or pPush if there is none.
+   * Set num to the block number. The index entries are valid if their
+   * block was not popped and if they were not reused by a more recent
+   * block: the newest valid one older than the time, if any, starts a
+   * short scan, otherwise the scan starts from the FIFO queue head.
+   */
+
+    uint8_t *p = pPop;
+    uint16_t pNum = headStamp;
+
+    // oldest valid entry, then the following ones up to the given time
+    const uint16_t span =
+      (uint16_t)(FIFOEE_TIMESTAMP_INDEX * FIFOEE_TIMESTAMP_STRIDE);
+    uint16_t first = (uint16_t)(tailStamp - headStamp) > span ?
+      tailStamp - span : headStamp;
+    for (uint16_t n = first + FIFOEE_TIMESTAMP_STRIDE - 1 &
+      ~(uint16_t)(FIFOEE_TIMESTAMP_STRIDE - 1);
+      (uint16_t)(n - headStamp) < usedBlocks; n += FIFOEE_TIMESTAMP_STRIDE) {
+      uint8_t entry = n / FIFOEE_TIMESTAMP_STRIDE &
+        (FIFOEE_TIMESTAMP_INDEX - 1);
+      if (after ? timeIndex[entry] > time : timeIndex[entry] >= time)
+        break;
+      p = pRBufStart + timeOffsets[entry];
+      pNum = n;
+    }
+
+    // short scan up to the block
+    while (p != pPush) {
+      uint8_t header;
+      uint8_t hSize;
+      size_t size = readHeader(p,&header,&hSize);
+      uint32_t blockTime = readTime(wrap(p + hSize + SEQUENCE_SIZE));
+      if (after ? blockTime > time : blockTime >= time)
+        break;
+      p = wrap(p + size);
+      pNum++;
+    }
+    *num = pNum;
+
+    return p;
+
+  }
+  #endif
+
+  #if defined(FIFOEE_SEQUENCE) || defined(FIFOEE_TIMESTAMP)
+  void indexStart(void) {
+  /* start the rebuild of the sequence and time indexes from the FIFO
+   * queue head, done by indexStep
+   */
+
+    pIndex = pPop;
+    indexNum = 0;
+
+  }
+
+
+  int indexStep(size_t maxBlocks) {
+  /* go on with the index rebuild, walking up to maxBlocks used blocks.
+   * Return IN_PROGRESS if the rebuild is not completed, otherwise SUCCESS.
+   */
+
+    for (size_t walked = 0; walked < maxBlocks; walked++) {
+      if (indexNum >= usedBlocks)
+        break;
+      uint8_t header;
+      uint8_t hSize;
+      size_t size = readHeader(pIndex,&header,&hSize);
+      #ifdef FIFOEE_SEQUENCE
+      uint16_t seq = headSeq + indexNum;
+      if (!(seq & (FIFOEE_SEQUENCE_STRIDE - 1)))
+        seqIndex[seq / FIFOEE_SEQUENCE_STRIDE &
+          (FIFOEE_SEQUENCE_INDEX - 1)] = pIndex - pRBufStart;
+      #endif
+      #ifdef FIFOEE_TIMESTAMP
+      if (!(indexNum & (FIFOEE_TIMESTAMP_STRIDE - 1)))
+        indexTime(indexNum,pIndex,
+          readTime(wrap(pIndex + hSize + SEQUENCE_SIZE)));
+      #endif
+      pIndex = wrap(pIndex + size);
+      indexNum++;
+    }
+
+    return indexNum < usedBlocks ? IN_PROGRESS : SUCCESS;
+
+  }
+  #endif
+
+
+  uint8_t writeHeader(uint8_t *p,uint8_t status,size_t size,
+    bool extended = false) {
+  /* write the header of the block pointed by p, with the given status and
+   * block size (header included). Blocks bigger than BLOCK_SIZE_MAX - 1,
+   * or any block if extended is true, get an extended header: the first
+   * byte, written last, is the extended size code, followed by the data
+   * size, MSB first. Return the header size.
+   */
+
+    #ifdef FIFOEE_EXTENDED_SIZE
+    if (extended || size > EXTENDED_SIZE_CODE) {
+      size -= EXTENDED_HEADER_SIZE;
+      eeWrite(wrap(p + 1),size >> 8);
+      eeWrite(wrap(p + 2),size & 0xff);
+      eeWrite(p,status | EXTENDED_SIZE_CODE);
+      return EXTENDED_HEADER_SIZE;
+    }
+    #else
+    (void)extended;
+    #endif
+
+    eeWrite(p,status | (size - 1));
+
+    return 1;
+
+  }
+
+
+  size_t readBotOffset(void) {
+  /* read the offset of the bottommost block
+   */
+
+    #ifdef FIFOEE_EXTENDED_SIZE
+    return eeRead(pBotBlockOffset) | (size_t)eeRead(pBotBlockOffset + 1) << 8;
+    #else
+    return eeRead(pBotBlockOffset);
+    #endif
+
+  }
+
+
+  void writeBotOffset(size_t offset) {
+  /* write the offset of the bottommost block
+   */
+
+    eeWrite(pBotBlockOffset,offset & 0xff);
+    #ifdef FIFOEE_EXTENDED_SIZE
+    eeWrite(pBotBlockOffset + 1,offset >> 8);
+    #endif
+
+  }
+
+
+  void writeRing(uint8_t *p,const uint8_t *data,size_t size) {
+  /* copy data to the ring buffer starting from p, the copy wraps at
+   * ring buffer end back to start.
+   */
+
+    // copy first data part up to the ring buffer end
+    if (p + size > pRBufEnd) {
+      size_t partSize = pRBufEnd - p;
+      eeWriteBlock(p,data,partSize);
+      data += partSize;
+      size -= partSize;
+      p = pRBufStart;
+    }
+
+    // copy (remaining) data
+    eeWriteBlock(p,data,size);
+
+  }
+
+
+  void readRing(uint8_t *p,uint8_t *data,size_t size) {
+  /* copy data from the ring buffer starting from p, the copy wraps at
+   * ring buffer end back to start.
+   */
+
+    // copy first data part up to the ring buffer end
+    if (p + size > pRBufEnd) {
+      size_t partSize = pRBufEnd - p;
+      eeReadBlock(p,data,partSize);
+      data += partSize;
+      size -= partSize;
+      p = pRBufStart;
+    }
+
+    // copy (remaining) data
+    eeReadBlock(p,data,size);
+
+  }
+
 
-      EE_WRITE(pBlock,FREE_BLOCK | FIFOEE_DATA_SIZE_MAX);
-      pBlock += BLOCK_SIZE_MAX;
-      sizeToFill -= BLOCK_SIZE_MAX;
+  uint8_t eeRead(uint8_t *addr) {
+  /* read a byte from the storage medium, through the cache if present
+   */
 
-    }
+    #ifdef FIFOEE_CACHE
+    return cacheRead(addr);
+    #else
+    return devRead(addr);
+    #endif
 
-    // set residual space
-    EE_WRITE(pBlock,FREE_BLOCK | sizeToFill - 1);
+  }
 
-    #if (defined(ESP8266) || defined(ESP32)) && !defined FIFOEE_RAM
-    EEPROM.commit();
-    nextCommit = millis() + commitPeriod;
-    #endif
 
-    return SUCCESS;
+  void eeWrite(uint8_t *addr,uint8_t val) {
+  /* write a byte to the storage medium, through the cache if present
+   */
+
+    #ifdef FIFOEE_CACHE
+    cacheWrite(addr,val);
+    #else
+    devWrite(addr,val);
+    #endif
 
   }
 
 
-  // class initializer
-  int begin(void) {
-  /* Class instance init
-   * Scan the ring buffer for a valid data structure. If yes,
-   * gather all relevant data for its management. If not,
-   * return an error code.
+  void eeReadBlock(uint8_t *addr,uint8_t *data,size_t size) {
+  /* read contiguous bytes from the storage medium in a single burst or,
+   * if present, through the cache, one copy for each cache line.
    */
 
-    // if required, begin EEPROM
-    #ifndef EEPROM_PROGRAM_BEGIN
-    #if !defined(FIFOEE_RAM) && !defined(__AVR__)
-    if (eepromBegin) {
-      #if defined ESP8266
-      EEPROM.begin((size_t)pRBufStart + rBufSize);
-      #elif defined(ESP32)
-      if (!EEPROM.begin((size_t)pRBufStart + rBufSize)) {
-        Serial.println("ERROR: EEPROM init failure");
-        while(true) delay(1000);
-      }
-      delay(500);
-      #endif
-      eepromBegin = false;
+    #ifdef FIFOEE_CACHE
+    while (size) {
+      cacheLine *line = cacheLoad(addr);
+      size_t partSize = line->page + cachePageSize(line->page) - addr;
+      if (partSize > size)
+        partSize = size;
+      memcpy(data,&line->data[addr - line->page],partSize);
+      addr += partSize;
+      data += partSize;
+      size -= partSize;
     }
-    #endif
+    #else
+    devReadBlock(addr,data,size);
     #endif
 
-    // scan the blocks sequence in the ring buffer for changes of status
-    // to find the position of pointers pPush, pPop, pRead.
-    pBotBlock = pRBufStart + EE_READ(pBotBlockOffset);
-    blockHeader = EE_READ(pBotBlock);
+  }
 
-    // check for invalid header (0x00: used block cannot have zero size)
-    if (!blockHeader)
-      return INVALID_BLOCK_HEADER;
 
-    // init pointers and control variables for an empty ring buffer
-    pBlock = pBotBlock;
-    pPush = pBlock;
-    pPop = pBlock;
-    pRead = pBlock;
+  void eeWriteBlock(uint8_t *addr,const uint8_t *data,size_t size) {
+  /* write contiguous bytes to the storage medium in a single burst or,
+   * if present, through the cache, one copy for each cache line.
+   */
 
-    // scan blocks into ring buffer for change of status and block size
-    blockStatus = blockHeader & BLOCK_STATUS_BIT;
-    uint8_t oldStatus = blockStatus;
-    size_t detectedRBufSize = (blockHeader & BLOCK_SIZE_BITS) + 1;
-    while (1) {
+    #ifdef FIFOEE_CACHE
+    while (size) {
+      cacheLine *line = cacheLoad(addr);
+      size_t partSize = line->page + cachePageSize(line->page) - addr;
+      if (partSize > size)
+        partSize = size;
+      uint8_t *pData = &line->data[addr - line->page];
+      if (memcmp(pData,data,partSize)) {
+        memcpy(pData,data,partSize);
+        line->dirty = true;
+        line->modified = ++cacheClock;
+      }
+      addr += partSize;
+      data += partSize;
+      size -= partSize;
+    }
+    #else
+    devWriteBlock(addr,data,size);
+    #endif
 
-      // point to next block
-      pBlock += (blockHeader & BLOCK_SIZE_BITS) + 1;
+  }
 
-      // if end of block chain (reached the ring buffer end) ...
-      if (pBlock >= pRBufEnd) {
-	
-	// check if block linked list closes over itself: topmost block
-	// must link to bottommost block.
-	if (pBotBlock != pBlock - rBufSize)
-	  return UNCLOSED_BLOCK_LIST;
 
-        // check if block sizes summation == given ring buffer size
-	if (rBufSize != detectedRBufSize)
-	  return WRONG_RBUFFER_SIZE;
+  uint8_t devRead(uint8_t *addr) {
+  /* read a byte from the storage medium, counting it for trace
+   */
 
-	break;
-      }
+    #ifdef FIFOEE_TRACE
+    if (traceTop)
+      trace[traceTop->op].bytesRead++;
+    #endif
 
-      // get next block status and check it for validity
-      blockHeader = EE_READ(pBlock);
-      if (!blockHeader)
-        return INVALID_BLOCK_HEADER;
+    return dev.read(addr);
 
-      blockStatus = blockHeader & BLOCK_STATUS_BIT;
+  }
 
-      // accumulate block sizes
-      detectedRBufSize += (blockHeader & BLOCK_SIZE_BITS) + 1;
 
-      // go on untill there is a change of status
-      if (oldStatus == blockStatus)
-	continue;
+  void devReadBlock(uint8_t *addr,uint8_t *data,size_t size) {
+  /* read contiguous bytes from the storage medium, counting them for
+   * trace
+   */
 
-      // there is a change of status in block sequence, process it.
-      uint8_t oldStatusSaved = oldStatus;
-      oldStatus = blockStatus;
-      switch (oldStatusSaved) {
+    #ifdef FIFOEE_TRACE
+    if (traceTop)
+      trace[traceTop->op].bytesRead += size;
+    #endif
 
-	// previous blocks have free status: next block is the head of
-	// the FIFO queue.
-	case FREE_BLOCK:
+    dev.readBlock(addr,data,size);
 
-          pPop = pBlock;
-	  pRead = pBlock;
-	  continue;
+  }
 
-	// previous blocks have used status: next block must nave a free
-	// status and it is the tail of the FIFO queue.
-	case USED_BLOCK:
 
-	  pPush = pBlock;
-	  continue;
-      }
-    }
+  void devWrite(uint8_t *addr,uint8_t val) {
+  /* write a byte to the storage medium, counting it for wear statistics
+   * and trace
+   */
 
-    return SUCCESS;
+    #ifdef FIFOEE_WEAR_REGIONS
+    if (!inPlace<Backend>(0) || dev.read(addr) != val)
+      countWrites(addr,1);
+    #endif
+    #ifdef FIFOEE_TRACE
+    if (traceTop)
+      trace[traceTop->op].bytesWritten++;
+    #endif
+
+    dev.write(addr,val);
 
   }
- 
 
-  int push(uint8_t *data, size_t size) {
-  /* push data to EEPROM (write a new block)
+
+  void devWriteBlock(uint8_t *addr,const uint8_t *data,size_t size) {
+  /* write contiguous bytes to the storage medium, counting them for wear
+   * statistics and trace
    */
 
-    // current push block must be free
-    blockHeader = EE_READ(pPush);
-    blockStatus = blockHeader & BLOCK_STATUS_BIT;
-    if (blockStatus != FREE_BLOCK)
-      return PUSH_BLOCK_NOT_FREE;
-    
-    //// allocate required data size. If current pPush block is smaller
-    // than the requested size, merge the following free blocks until
-    // the requested size + 3 is satisfied or exceeded.
-    size_t blockSize = (blockHeader & BLOCK_SIZE_BITS) + 1;
+    #ifdef FIFOEE_WEAR_REGIONS
+    if (!inPlace<Backend>(0))
+      countWrites(addr,size);
+    else
+      for (size_t i = 0; i < size; i++)
+        if (dev.read(addr + i) != data[i])
+          countWrites(addr + i,1);
+    #endif
+    #ifdef FIFOEE_TRACE
+    if (traceTop)
+      trace[traceTop->op].bytesWritten += size;
+    #endif
 
-    while (size + 1 > blockSize) {
+    dev.writeBlock(addr,data,size);
 
-      pBlock = pPush + blockSize;
+  }
 
-      while (pBlock >= pRBufEnd)
-	pBlock -= rBufSize;
-	
-      if (pBlock == pPush) 
-        return FIFO_FULL;
 
-      blockHeader = EE_READ(pBlock);
-      blockStatus = blockHeader & BLOCK_STATUS_BIT;
+  #ifdef FIFOEE_WEAR_REGIONS
+  template <class B>
+  static constexpr bool inPlace(decltype(B::updateInPlace) *) {
+  /* the updateInPlace constant of backend B, false if it has none
+   */
 
-      if (blockStatus != FREE_BLOCK)
-        return FIFO_FULL;
+    return B::updateInPlace;
 
-      blockSize += (blockHeader & BLOCK_SIZE_BITS) + 1;
-    }
+  }
 
-    //// manage 2 relevant cases of required block size (size + 1) vs
-    // the allowable free block size space found above (blockSize).
 
-    // case #1: required size <= free size, allocate required size and
-    // make a new free block to fill the residual space.
-    if (size + 1 < blockSize) {
+  template <class B> static constexpr bool inPlace(...) { return false; }
+
 
-      pBlock = pPush + size + 1;
+  void countWrites(uint8_t *addr,size_t size) {
+  /* add the given write to the counters of the metadata bytes and of the
+   * ring buffer regions that it spans
+   */
 
-      while (pBlock >= pRBufEnd)
-        pBlock -= rBufSize;
+    wear.bytesWritten += size;
 
-      EE_WRITE(pBlock,FREE_BLOCK | blockSize - size - 2);
+    for (; size && addr < pRBufStart; addr++, size--)
+      wear.metadataWrites[addr - pBotBlockOffset]++;
 
+    while (size) {
+      size_t offset = addr - pRBufStart;
+      size_t region = offset / wear.regionSize;
+      size_t partSize = (region + 1) * wear.regionSize - offset;
+      if (partSize > size)
+        partSize = size;
+      wear.regionWrites[region] += partSize;
+      addr += partSize;
+      size -= partSize;
     }
 
-    // case #2: required size == free size, if next block is free go on.
-    // Otherwise, return FIFO full.
-    else {
+  }
+  #endif
 
-      pBlock = pPush + blockSize;
 
-      while (pBlock >= pRBufEnd)
-        pBlock -= rBufSize;
+  #ifdef FIFOEE_TRACE
+  struct traceScope {
+  /* trace of an operation, from the scope construction at the method start
+   * to its destruction at the method return. The storage accesses and the
+   * block headers are counted to the innermost running operation, the
+   * duration of a nested operation is taken off from the one containing
+   * it. Nested operations of the same kind are not traced, they belong to
+   * the outer one, i.e. begin calling beginStep.
+   */
 
-      if (pBlock == pPush)
-        return FIFO_FULL;
+    BasicFIFOEE *fifo;
+    traceScope *outer;
+    uint8_t op;
+    uint32_t start;
+    uint32_t nested = 0;            // duration of nested operations (us)
 
-      blockHeader = EE_READ(pBlock);
-      blockStatus = blockHeader & BLOCK_STATUS_BIT;
+    traceScope(BasicFIFOEE *aFifo,uint8_t anOp):
+      fifo(aFifo), outer(aFifo->traceTop), op(anOp) {
 
-      if (blockStatus != FREE_BLOCK)
-        return FIFO_FULL;
+      if (outer && outer->op == op) {
+        fifo = NULL;
+        return;
+      }
+      fifo->traceTop = this;
+      start = micros();
 
     }
- 
-    //// copy given data to eeprom data block
-    uint8_t *pData;
 
-    // if the block is splitted (block wraps at FIFO buffer end back to start)
-    if (pPush + size + 1 > pRBufEnd) {
 
-      //  copy first data part
-      for (pData=pPush+1; pData < pRBufEnd; pData++)
-        EE_WRITE(pData,*data++);
- 
-      //  copy second data part
-      for (pData=pRBufStart; pData < pPush + size + 1 - rBufSize;  pData++)
-        EE_WRITE(pData,*data++);
+    ~traceScope() {
+
+      if (!fifo)
+        return;
 
-      // update offset of bottom block
-      EE_WRITE(pBotBlockOffset,pData - pRBufStart);
+      uint32_t elapsed = micros() - start;
+      traceStats &stats = fifo->trace[op];
+      stats.calls++;
+      stats.totalMicros += elapsed - nested;
+      if (elapsed - nested > stats.maxMicros)
+        stats.maxMicros = elapsed - nested;
+      if (outer)
+        outer->nested += elapsed;
+      fifo->traceTop = outer;
 
     }
 
-    // if the block is not splitted (block does not overflow FIFO buffer end)
-    else {
+  };
+  #endif
+
+
+  #ifdef FIFOEE_CHECKPOINT_SLOTS
+  int resumeCheckpoint(void) {
+  /* restore pPush, pPop, pRead from the newest valid checkpoint slot.
+   * Blocks boundaries from checkpoint pop offset onward cannot change while
+   * the checkpoint is valid, so only the blocks changed after it are
+   * scanned: the blocks popped after the checkpoint, forward from its pop
+   * offset, then the blocks pushed after the checkpoint, forward from its
+   * push offset. If no valid slot exists or the slot is not coherent with
+   * the ring buffer content, return an error code to request a full scan.
+   */
 
-      //  copy data
-      for (pData=pPush+1; pData < pPush + size + 1; pData++)
-        EE_WRITE(pData,*data++);
+    // find the newest slot with a valid crc
+    int newest = -1;
+    uint8_t slot[CHECKPOINT_SLOT_SIZE];
+    for (int i = 0; i < FIFOEE_CHECKPOINT_SLOTS; i++) {
+
+      eeReadBlock(pCheckpoint + i * CHECKPOINT_SLOT_SIZE,slot,
+        CHECKPOINT_SLOT_SIZE);
+      if (crc8(slot,CHECKPOINT_SLOT_SIZE - 1) != slot[CHECKPOINT_SLOT_SIZE - 1])
+        continue;
+
+      if (newest < 0 || (int8_t)(slot[0] - cpSeq) > 0) {
+        newest = i;
+        cpSeq = slot[0];
+        cpPushOffset = slot[1] | (size_t)slot[2] << 8;
+        cpPopOffset = slot[3] | (size_t)slot[4] << 8;
+        cpBlockCount = slot[5] | (size_t)slot[6] << 8;
+      }
+    }
 
+    // next checkpoints follow the newest slot, also if it is not usable
+    if (newest < 0)
+      return INVALID_CHECKPOINT;
+    cpSlot = newest;
+    if (cpPushOffset >= rBufSize || cpPopOffset >= rBufSize)
+      return INVALID_CHECKPOINT;
+
+    // the FIFO queue at checkpoint time, from checkpoint pop to push offset
+    size_t cpUsed = rBufSize - (cpPopOffset > cpPushOffset ?
+      cpPopOffset - cpPushOffset : rBufSize - cpPushOffset + cpPopOffset);
+    if (cpPushOffset == cpPopOffset)
+      cpUsed = 0;
+
+    // skip free blocks popped after checkpoint
+    size_t scanned = 0;
+    size_t poppedBlocks = 0;
+    pBlock = pRBufStart + cpPopOffset;
+    while (1) {
+      blockSize = readHeader(pBlock);
+      if (!blockHeader || blockSize > rBufSize)
+        return INVALID_CHECKPOINT;
+      if (blockStatus == USED_BLOCK)
+        break;
+      poppedBlocks++;
+      scanned += blockSize;
+      pBlock = wrap(pBlock + blockSize);
+      // all blocks are free: FIFO empty
+      if (scanned >= rBufSize) {
+        if (scanned > rBufSize)
+          return INVALID_CHECKPOINT;
+        break;
+      }
     }
+    pPop = pBlock;
+    pRead = pBlock;
 
-    // set size and status for copied data block
-    EE_WRITE(pPush,USED_BLOCK | size);
+    // used blocks up to checkpoint push offset are not changed: skip them
+    usedBlocks = 0;
+    if (scanned < cpUsed) {
+      if (poppedBlocks > cpBlockCount)
+        return INVALID_CHECKPOINT;
+      usedBlocks = cpBlockCount - poppedBlocks;
+      scanned = cpUsed;
+      pBlock = pRBufStart + cpPushOffset;
+    }
 
-    // update push pointer to next block and bottommost block offset
-    // from pRBufStart 
-    if (pData < pRBufEnd)
-      pPush = pData;
-    else {
-      pPush = pRBufStart;
-      // update offset of bottom block
-      EE_WRITE(pBotBlockOffset,0);
+    // skip used blocks pushed after checkpoint
+    while (scanned < rBufSize) {
+      blockSize = readHeader(pBlock);
+      if (!blockHeader || blockSize > rBufSize)
+        return INVALID_CHECKPOINT;
+      if (blockStatus == FREE_BLOCK)
+        break;
+      usedBlocks++;
+      scanned += blockSize;
+      pBlock = wrap(pBlock + blockSize);
     }
+    if (scanned >= rBufSize && pBlock != pPop)
+      return INVALID_CHECKPOINT;
+    pPush = pBlock;
 
-    #if (defined(ESP8266) || defined(ESP32)) && !defined FIFOEE_RAM
-    commitRequest();
-    #endif
+    // restore the checkpoint validity state
+    cpValid = true;
+    cpFree = rBufSize - cpUsed;
+    cpPushed = pPush >= pRBufStart + cpPushOffset ?
+      pPush - pRBufStart - cpPushOffset :
+      rBufSize - cpPushOffset + (pPush - pRBufStart);
 
     return SUCCESS;
 
   }
 
 
-  int pop(uint8_t *data,size_t *size) {
-  /* pop out a block: copy data of the current pop block from the FIFO
-   * ring buffer to a given data buffer and mark the popped block in the
-   * FIFO ring buffer as "free", ready to be used to store another
-   * incoming block. The pop pointer in the ring buffer is moved to
-   * the next block.
+  void invalidateCheckpoint(void) {
+  /* mark all checkpoint slots as invalid, from the oldest to the newest,
+   * so an interrupted invalidation leaves valid only the newest slot.
+   * A slot is invalidated writing the complement of its crc.
    */
 
-    // if ring buffer is empty
-    if (pPop == pPush)
-      return FIFO_EMPTY;
-
-    // copy data from ring buffer to given data buffer
-    pBlock = pPop;
-    if (int rc = readData(data,size))
-      return rc;
+    uint8_t slot[CHECKPOINT_SLOT_SIZE - 1];
+    for (int i = 1; i <= FIFOEE_CHECKPOINT_SLOTS; i++) {
 
-    // mark block just read as deleted
-    EE_WRITE(pPop,FREE_BLOCK | blockSize - 1);
+      uint8_t *pSlot = pCheckpoint + ((cpSlot + i) % FIFOEE_CHECKPOINT_SLOTS)
+        * CHECKPOINT_SLOT_SIZE;
+      eeReadBlock(pSlot,slot,CHECKPOINT_SLOT_SIZE - 1);
+      eeWrite(pSlot + CHECKPOINT_SLOT_SIZE - 1,
+        crc8(slot,CHECKPOINT_SLOT_SIZE - 1) ^ 0xff);
+    }
+    cpValid = false;
 
-    #if (defined(ESP8266) || defined(ESP32)) && !defined FIFOEE_RAM
-    commitRequest();
-    #endif
+  }
+  #endif
 
-    // read pointer must be always at or before pop pointer
-    if (pRead == pPop)
-      pRead = pBlock;
 
-    // move pop pointer to next block
-    pPop = pBlock;
+  #ifdef FIFOEE_SEGMENTS
+  uint8_t segmentOf(size_t offset) {
+  /* return the ring buffer segment of the given offset, the last segment
+   * takes also the remainder of the ring buffer size
+   */
 
-    return SUCCESS;
+    size_t segment = offset / segmentSize;
+    return segment < FIFOEE_SEGMENTS ? segment : FIFOEE_SEGMENTS - 1;
 
   }
+  #endif
 
 
-  int read(uint8_t *data,size_t *size) {
-  /* read a block: copy data of the current read block from FIFO ring
-   * buffer to a given data buffer and mark the read block in the FIFO
-   * ring buffer as "read". The read pointer of the ring buffer is
-   * moved to the next block.
+  #ifdef FIFOEE_CACHE
+  cacheLine *cacheLoad(uint8_t *addr) {
+  /* return the cache line holding the EEPROM page of the given address.
+   * Pages are aligned to the FIFO buffer start. On a miss, the least
+   * recently used line is replaced, after flushing all dirty lines if
+   * it is dirty, and the page is read from EEPROM in a single burst.
    */
 
-    // if ring buffer is empty
-    if (pRead == pPush)
-      return FIFO_EMPTY;
+    uint8_t *page = pBotBlockOffset + (addr - pBotBlockOffset)
+      / FIFOEE_CACHE_PAGE_SIZE * FIFOEE_CACHE_PAGE_SIZE;
 
-    // copy data from ring buffer to given data buffer
-    pBlock = pRead;
-    if (int rc = readData(data,size))
-      return rc;
+    // look for a hit and for the replacement line
+    cacheLine *line = cache;
+    for (uint8_t i = 0; i < FIFOEE_CACHE_PAGES; i++) {
+      if (cache[i].page == page) {
+        cache[i].used = ++cacheClock;
+        return &cache[i];
+      }
+      if (!cache[i].page)
+        line = &cache[i];
+      else if (line->page && (int16_t)(cache[i].used - line->used) < 0)
+        line = &cache[i];
+    }
 
-    // update read pointer
-    pRead = pBlock;
+    // replace line
+    if (line->dirty)
+      cacheFlush();
+
+    line->page = page;
+    line->used = ++cacheClock;
+    devReadBlock(page,line->data,cachePageSize(page));
+
+    return line;
 
-    return SUCCESS;
-    
   }
- 
 
-  void restartRead(void) {
-  /* the read pointer is moved to the oldest data block, the FIFO queue head.
-   * WARNING: already read block status is NOT changed. So, at FIFO begin,
-   * all previous restarts are lost.
+
+  uint8_t cacheRead(uint8_t *addr) {
+  /* read a byte through the cache
    */
 
-    // restart reading
-    pRead = pPop;
+    cacheLine *line = cacheLoad(addr);
+    return line->data[addr - line->page];
 
   }
 
 
-  private:
+  void cacheWrite(uint8_t *addr,uint8_t val) {
+  /* write a byte into the cache, the line is marked as dirty and as the
+   * last modified.
+   */
 
-  int readData(uint8_t *data,size_t *size) {
-  /* copy all data of block pointed by pBlock from the FIFO ring buffer to
-   * the given data buffer. If data block is splitted into a part at ring
-   * buffer top and what remains at buffer bottom, copy both as if they
-   * were a single block. If the data buffer size is too small for data
-   * block size, do not copy it and return a proper error code. Otherwise,
-   * return success (0). Also return the size of copied data. The pBlock
-   * pointer is set to point to the next block.
+    cacheLine *line = cacheLoad(addr);
+    uint8_t *pData = &line->data[addr - line->page];
+    if (*pData == val)
+      return;
+
+    *pData = val;
+    line->dirty = true;
+    line->modified = ++cacheClock;
+
+  }
+
+
+  size_t cachePageSize(uint8_t *page) {
+  /* size of the given page, the last page is clipped at FIFO buffer end
    */
 
-    // check for sufficient data size
-    blockSize = (EE_READ(pBlock) & BLOCK_SIZE_BITS) + 1;
-    if (blockSize - 1 > *size)
-      return DATA_BUFFER_SMALL;
+    return page + FIFOEE_CACHE_PAGE_SIZE > pRBufEnd ?
+      pRBufEnd - page : FIFOEE_CACHE_PAGE_SIZE;
+
+  }
+
 
-    //// copy data from eeprom to the given data buffer.
-    uint8_t *pData;
-    *size = blockSize - 1;
+  void cacheFlush(void) {
+  /* write all dirty lines to EEPROM, one burst for each line, in the order
+   * of their last modification. So, the last written byte, the block
+   * header for push and pop, reaches the EEPROM last.
+   */
 
-    // if the block is splitted ...
-    if (pBlock + blockSize > pRBufEnd) {
+    while (1) {
 
-      // copy first data part at end of ring buffer
-      for (pData=pBlock+1; pData < pRBufEnd; pData++)
-        *data++ = EE_READ(pData);
+      cacheLine *line = NULL;
+      for (uint8_t i = 0; i < FIFOEE_CACHE_PAGES; i++)
+        if (cache[i].dirty && (!line ||
+          (int16_t)(cache[i].modified - line->modified) < 0))
+          line = &cache[i];
 
-      // copy second data part at start of ring buffer
-      for (pData=pRBufStart; pData < pBlock + blockSize - rBufSize; pData++)
-        *data++ = EE_READ(pData);
+      if (!line)
+        return;
 
+      devWriteBlock(line->page,line->data,cachePageSize(line->page));
+      line->dirty = false;
     }
 
-    // if the block is not splitted ...
-    else {
+  }
+  #endif
+
 
-      // copy data
-      for (pData=pBlock+1; pData < pBlock + blockSize; pData++)
-        *data++ = EE_READ(pData);
+  static uint8_t crc8(const uint8_t *data,size_t size) {
+  /* CRC-8, polynomial 0x07, initial value 0xff
+   */
 
+    uint8_t crc = 0xff;
+    while (size--) {
+      crc ^= *data++;
+      for (uint8_t i = 0; i < 8; i++)
+        crc = crc & 0x80 ? crc << 1 ^ 0x07 : crc << 1;
     }
 
-    // next block pointer
-    if (pData < pRBufEnd)
-      pBlock = pData;
-    else
-      pBlock = pRBufStart;
+    return crc;
 
-    return SUCCESS;
-    
   }
 
 
-  #if (defined(ESP8266) || defined(ESP32)) && !defined FIFOEE_RAM
-  void commitRequest(void) {
-  /* commit changes to EEPROM not more frequently than a given period
+  int commit(void) {
+  /* commit changes to the storage medium, taking a checkpoint before,
+   * if enabled
    */
 
-    if (!commitPeriod)
-      return;
+    TRACE_OPERATION(TRACE_COMMIT);
 
-    uint32_t now = millis();
-    if (now < nextCommit)
-      return;
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    checkpoint();
+    #endif
 
-    EEPROM.commit();
-    nextCommit = now + commitPeriod;
+    #ifdef FIFOEE_WEAR_REGIONS
+    if (dev.pending())
+      wear.commits++;
+    #endif
 
-    return;
+    if (!dev.commit())
+      return COMMIT_FAILURE;
+
+    return SUCCESS;
 
   }
-  #endif
 
 
   /**** optional debug member functions ****/
@@ -606,13 +4408,34 @@ struct FIFOEE {
     Serial.print("rBufSize:       ");
     Serial.println((int)rBufSize,HEX);
     Serial.print("BotBlockOffset: ");
-    Serial.println((int)EE_READ(pBotBlockOffset),HEX);
+    Serial.println((int)readBotOffset(),HEX);
     Serial.print("pPush:          ");
     Serial.println((int)pPush,HEX);
     Serial.print("pPop:           ");
     Serial.println((int)pPop,HEX);
     Serial.print("pRead:          ");
     Serial.println((int)pRead,HEX);
+    #ifdef FIFOEE_SEQUENCE
+    Serial.print("headSeq:        ");
+    Serial.println((int)headSeq,HEX);
+    Serial.print("tailSeq:        ");
+    Serial.println((int)tailSeq,HEX);
+    #endif
+    #ifdef FIFOEE_TIMESTAMP
+    Serial.print("headStamp:      ");
+    Serial.println((int)headStamp,HEX);
+    Serial.print("tailStamp:      ");
+    Serial.println((int)tailStamp,HEX);
+    #endif
+    #ifdef FIFOEE_CURSORS
+    for (uint8_t i = 0; i < FIFOEE_CURSORS; i++)
+      if (pCursor[i]) {
+        Serial.print("pCursor[");
+        Serial.print(i);
+        Serial.print("]:     ");
+        Serial.println((int)pCursor[i],HEX);
+      }
+    #endif
 
   }
 
@@ -623,7 +4446,7 @@ struct FIFOEE {
 
     for (uint8_t *addr = pRBufStart; addr < pRBufEnd;) {
 
-      Serial.print((int)addr, HEX);
+      Serial.print((int)(size_t)addr, HEX);
       Serial.print(":");
       uint8_t *lineEnd;
       lineEnd = addr + 16;
@@ -633,7 +4456,7 @@ struct FIFOEE {
       for (addr; addr < lineEnd; addr++) {
 
         Serial.print(" ");
-        uint8_t value = EE_READ(addr);
+        uint8_t value = eeRead(addr);
         if (value < 16)
 	  Serial.print("0");
         Serial.print((int)value, HEX);
@@ -644,10 +4467,50 @@ struct FIFOEE {
 
   }
 
+
+  #ifdef FIFOEE_WEAR_REGIONS
+  void dumpWear(void) {
+  /* print out wear counters, one line for each metadata byte and for
+   * each ring buffer region, with its start address.
+   */
+
+    Serial.print("bytesWritten:   ");
+    Serial.println(wear.bytesWritten);
+    Serial.print("commits:        ");
+    Serial.println(wear.commits);
+
+    for (size_t i = 0; i < METADATA_SIZE; i++) {
+      Serial.print((int)(pBotBlockOffset + i),HEX);
+      Serial.print(": ");
+      Serial.println(wear.metadataWrites[i]);
+    }
+
+    for (size_t i = 0; i < FIFOEE_WEAR_REGIONS; i++) {
+      Serial.print((int)(pRBufStart + i * wear.regionSize),HEX);
+      Serial.print(": ");
+      Serial.println(wear.regionWrites[i]);
+    }
+
+  }
+  #endif
+
   #endif
 
 };
 
+
+/**** default FIFOEE class of the board ****/
+
+#ifdef FIFOEE_RAM
+  typedef BasicFIFOEE<FIFOEERamBackend> FIFOEE;
+#elif defined(__AVR__)
+  typedef BasicFIFOEE<FIFOEEAvrBackend> FIFOEE;
+#elif defined(ESP8266) || defined(ESP32)
+  typedef BasicFIFOEE<FIFOEEEspBackend> FIFOEE;
+#else
+  #error ERROR: unsupported architecture 
+#endif
+
 #endif
 
 /**** end ****/
@@ -0,0 +1,285 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : FIFOEE backends for external EEPROM
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  Storage backends of BasicFIFOEE for external serial EEPROM and FRAM with
+  16 bits addresses: I2C 24LCxx EEPROM (24LC32 up to 24LC512) and FM24xx
+  FRAM, SPI 25xx EEPROM (25LC320 up to 25LC512) and FM25xx FRAM. Writes are
+  split into bursts aligned to the device pages. A write not acknowledged
+  or not completed in time is latched as failed, so the FIFO operations
+  return COMMIT_FAILURE until the next FIFO begin or format. The I2C or SPI
+  bus must be begun by the application before the FIFO begin or format,
+  e.g.
+    #include <fifoee_external.h>
+    BasicFIFOEE<FIFOEEI2CBackend> fifo((uint8_t *)0,4096,
+      FIFOEEI2CBackend(0x50));
+    ...
+    Wire.begin();
+    fifo.begin();
+
+.- */
+
+#ifndef FIFOEE_EXTERNAL_H
+#define FIFOEE_EXTERNAL_H
+
+#include <Wire.h>
+#include <SPI.h>
+#include "fifoee.h"
+
+
+/**** constants ****/
+
+// device pages
+#define EEPROM_PAGE_SIZE 64      // 24LC256, 25LC256, see device datasheet
+#define FRAM_PAGE_SIZE 0         // FRAM: no pages and no write cycle
+
+// I2C 24LCxx
+#define I2C_EEPROM_ADDRESS 0x50  // device address with A2,A1,A0 at ground
+#define I2C_WRITE_TIMEOUT 10     // max write cycle time (ms)
+#define I2C_READ_CHUNK_SIZE 16   // bytes read by each bus transaction
+#define I2C_WRITE_CHUNK_SIZE 30  // bytes written by each bus transaction
+
+// SPI 25xx instructions and status register bits
+#define SPI_EEPROM_READ 0x03
+#define SPI_EEPROM_WRITE 0x02
+#define SPI_EEPROM_WREN 0x06
+#define SPI_EEPROM_RDSR 0x05
+#define SPI_EEPROM_WIP 0x01      // write in progress
+#define SPI_EEPROM_CLOCK 4000000 // bus clock (Hz)
+#define SPI_WRITE_TIMEOUT 10     // max write cycle time (ms)
+
+
+/**** backends ****/
+
+inline size_t fifoeePageChunk(const uint8_t *addr,size_t size,
+  uint16_t pageSize) {
+/* number of bytes from addr up to the end of its device page, in the
+ * limit of size. A zero page size means no pages.
+ */
+
+  if (!pageSize)
+    return size;
+
+  size_t chunkSize = pageSize - (size_t)addr % pageSize;
+  return chunkSize < size ? chunkSize : size;
+
+}
+
+
+struct FIFOEEI2CBackend {
+/* FIFO into an I2C 24LCxx EEPROM or FM24xx FRAM. Reads are sequential
+ * bus reads. Writes are page writes, split at device page boundaries and
+ * at the bus buffer size. After each page write, the end of the EEPROM
+ * write cycle is detected by ACK polling: the device does not acknowledge
+ * its address until the write cycle is complete. A write not acknowledged
+ * or a write cycle lasting more than I2C_WRITE_TIMEOUT is latched as
+ * failed, reported by commit until the next begin.
+ */
+
+  TwoWire *wire;
+  uint8_t deviceAddress;
+  uint16_t pageSize;
+  bool writeFailed = false;
+
+  explicit FIFOEEI2CBackend(uint8_t aDeviceAddress = I2C_EEPROM_ADDRESS,
+    uint16_t aPageSize = EEPROM_PAGE_SIZE,TwoWire &aWire = Wire):
+    wire(&aWire), deviceAddress(aDeviceAddress), pageSize(aPageSize) {}
+
+  void begin(size_t) { writeFailed = false; }
+
+  uint8_t read(const uint8_t *addr) {
+    uint8_t val;
+    readBlock(addr,&val,1);
+    return val;
+  }
+
+  void write(uint8_t *addr,uint8_t val) { writeBlock(addr,&val,1); }
+
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+
+    // the bus buffer limits the bytes read by each transaction
+    while (size) {
+      uint8_t chunkSize = size > I2C_READ_CHUNK_SIZE ?
+        I2C_READ_CHUNK_SIZE : size;
+      wire->beginTransmission(deviceAddress);
+      wire->write((uint8_t)((size_t)addr >> 8));
+      wire->write((uint8_t)(size_t)addr);
+      wire->endTransmission(false);
+      wire->requestFrom(deviceAddress,chunkSize);
+      for (uint8_t i = 0; i < chunkSize; i++)
+        *buf++ = wire->read();
+      addr += chunkSize;
+      size -= chunkSize;
+    }
+
+  }
+
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+
+    while (size) {
+
+      // write up to the page end, in the limit of the bus buffer
+      size_t chunkSize = fifoeePageChunk(addr,size,pageSize);
+      if (chunkSize > I2C_WRITE_CHUNK_SIZE)
+        chunkSize = I2C_WRITE_CHUNK_SIZE;
+      wire->beginTransmission(deviceAddress);
+      wire->write((uint8_t)((size_t)addr >> 8));
+      wire->write((uint8_t)(size_t)addr);
+      for (size_t i = 0; i < chunkSize; i++)
+        wire->write(buf[i]);
+      if (wire->endTransmission())
+        writeFailed = true;
+      addr += chunkSize;
+      buf += chunkSize;
+      size -= chunkSize;
+
+      // wait for the end of the write cycle, FRAM has none
+      if (pageSize && !ackPolling())
+        writeFailed = true;
+    }
+
+  }
+
+  bool ackPolling(void) {
+    // false if the device does not acknowledge within the timeout. The
+    // device is polled once more after the timeout, a preemption between
+    // the last poll and the time check is not a failure.
+    uint32_t start = millis();
+    while (1) {
+      bool late = millis() - start >= I2C_WRITE_TIMEOUT;
+      wire->beginTransmission(deviceAddress);
+      if (!wire->endTransmission())
+        return true;
+      if (late)
+        return false;
+    }
+  }
+
+  // a true EEPROM needs no commit, a failed write is reported as a
+  // failed commit, due at once
+  void changed(size_t) {}
+  bool commitDue(void) { return writeFailed; }
+  bool pending(void) { return writeFailed; }
+  bool commit(void) { return !writeFailed; }
+
+};
+
+
+struct FIFOEESPIBackend {
+/* FIFO into a SPI 25xx EEPROM or FM25xx FRAM. Reads are sequential bus
+ * reads. Writes are page writes, split at device page boundaries. After
+ * each page write, the device status is polled for the end of the EEPROM
+ * write cycle. A write cycle lasting more than SPI_WRITE_TIMEOUT, i.e.
+ * with a missing device answering 0xff, is latched as failed, reported
+ * by commit until the next begin.
+ */
+
+  SPIClass *spi;
+  uint8_t csPin;
+  uint16_t pageSize;
+  bool writeFailed = false;
+
+  explicit FIFOEESPIBackend(uint8_t aCsPin,
+    uint16_t aPageSize = EEPROM_PAGE_SIZE,SPIClass &aSpi = SPI):
+    spi(&aSpi), csPin(aCsPin), pageSize(aPageSize) {}
+
+  void begin(size_t) {
+    pinMode(csPin,OUTPUT);
+    digitalWrite(csPin,HIGH);
+    writeFailed = false;
+  }
+
+  uint8_t read(const uint8_t *addr) {
+    uint8_t val;
+    readBlock(addr,&val,1);
+    return val;
+  }
+
+  void write(uint8_t *addr,uint8_t val) { writeBlock(addr,&val,1); }
+
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+
+    select();
+    spi->transfer(SPI_EEPROM_READ);
+    spi->transfer((uint8_t)((size_t)addr >> 8));
+    spi->transfer((uint8_t)(size_t)addr);
+    while (size--)
+      *buf++ = spi->transfer(0);
+    deselect();
+
+  }
+
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+
+    while (size) {
+
+      // enable write, write up to the page end
+      size_t chunkSize = fifoeePageChunk(addr,size,pageSize);
+      select();
+      spi->transfer(SPI_EEPROM_WREN);
+      deselect();
+      select();
+      spi->transfer(SPI_EEPROM_WRITE);
+      spi->transfer((uint8_t)((size_t)addr >> 8));
+      spi->transfer((uint8_t)(size_t)addr);
+      for (size_t i = 0; i < chunkSize; i++)
+        spi->transfer(buf[i]);
+      deselect();
+      addr += chunkSize;
+      buf += chunkSize;
+      size -= chunkSize;
+
+      // wait for the end of write cycle, FRAM has none
+      if (pageSize && !statusPolling())
+        writeFailed = true;
+    }
+
+  }
+
+  bool statusPolling(void) {
+    // false if the write is still in progress after the timeout, polled
+    // once more after it as for I2C
+    uint32_t start = millis();
+    while (1) {
+      bool late = millis() - start >= SPI_WRITE_TIMEOUT;
+      select();
+      spi->transfer(SPI_EEPROM_RDSR);
+      uint8_t status = spi->transfer(0);
+      deselect();
+      if (!(status & SPI_EEPROM_WIP))
+        return true;
+      if (late)
+        return false;
+    }
+  }
+
+  void select(void) {
+    spi->beginTransaction(SPISettings(SPI_EEPROM_CLOCK,MSBFIRST,SPI_MODE0));
+    digitalWrite(csPin,LOW);
+  }
+
+  void deselect(void) {
+    digitalWrite(csPin,HIGH);
+    spi->endTransaction();
+  }
+
+  // a true EEPROM needs no commit, a failed write is reported as a
+  // failed commit, due at once
+  void changed(size_t) {}
+  bool commitDue(void) { return writeFailed; }
+  bool pending(void) { return writeFailed; }
+  bool commit(void) { return !writeFailed; }
+
+};
+
+#endif
+
+/**** end ****/
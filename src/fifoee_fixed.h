@@ -0,0 +1,423 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : FIFOEE of fixed size records
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  FIFO of records with a size fixed at compile time, i.e. a struct. The
+  ring buffer is an array of slots, each one a status byte followed by the
+  record, so slot addresses are computed and push and pop take constant
+  time, with no block merge or split. The status byte has the free bit and
+  a lap bit, flipped by the pushes at each pass over the ring buffer: the
+  lap bit change marks the push slot, also when the FIFO is empty, so the
+  writes stay spread over all the slots across power cycles, e.g.
+    #include <fifoee_fixed.h>
+    FIFOEEFixed<sizeof(uint32_t)> fifo((uint8_t *)0,256);
+    ...
+    if (fifo.begin())
+      fifo.format();
+    fifo.push((uint8_t *)&upTime);
+
+  The compile options of FIFOEE, except the storage backend selection,
+  do not apply to this class.
+
+.- */
+
+#ifndef FIFOEE_FIXED_H
+#define FIFOEE_FIXED_H
+
+#include "fifoee.h"
+
+
+/**** constants ****/
+
+// metadata before the slots: format marker, record size (2 bytes, lsb first)
+#define FORMAT_FIXED 0xd1
+#define FIXED_METADATA_SIZE 3
+
+// slot status byte: free bit, lap bit and a fixed pattern
+#define SLOT_FREE FREE_BLOCK
+#define SLOT_LAP 0x40
+#define SLOT_PATTERN 0x3f
+
+
+/**** class ****/
+
+template <size_t RecordSize,class Backend>
+struct BasicFIFOEEFixed: FIFOEEBase {
+
+  static_assert(RecordSize > 0,"ERROR: record size must be not zero");
+
+  public:
+
+  // the storage backend class
+  typedef Backend backendType;
+
+  private:
+
+  /**** class constants ****/
+
+  static const size_t slotSize = RecordSize + 1;
+
+
+  /**** class control vars ****/
+
+  uint8_t *pMarker;
+  uint8_t *pSlots;
+  size_t slots;
+
+  size_t pushSlot;
+  size_t popSlot;
+  size_t usedSlots;
+  size_t readSlots;       // slots read after popSlot
+  uint8_t pushLap;        // lap bit of the slots pushed in this pass
+
+  Backend dev;
+
+
+  /**** class member functions ****/
+
+  public:
+
+  BasicFIFOEEFixed(uint8_t *aBuffer,size_t aBufSize) {
+  /* class constructor
+   * aBuffer: FIFO buffer start address, area for metadata and slots.
+   * aBufSize: buffer size (bytes).
+   */
+
+    init(aBuffer,aBufSize);
+
+  }
+
+
+  BasicFIFOEEFixed(uint8_t *aBuffer,size_t aBufSize,uint32_t aCommitPeriod):
+    dev(aCommitPeriod) {
+  /* class constructor for emulated EEPROM (ESP8266 and ESP32)
+   * aCommitPeriod: max delay (ms) from a change to its real write to
+   *   EEPROM (commit), zero disables timed commits.
+   */
+
+    init(aBuffer,aBufSize);
+
+  }
+
+
+  BasicFIFOEEFixed(uint8_t *aBuffer,size_t aBufSize,const Backend &aDev):
+    dev(aDev) {
+  /* class constructor with a given backend instance
+   * aDev: backend, i.e. an external EEPROM with its bus address.
+   */
+
+    init(aBuffer,aBufSize);
+
+  }
+
+
+  int format(void) {
+  /* write the metadata and mark all the slots as free, the FIFO is
+   * logically cleared.
+   */
+
+    if (!slots)
+      return INVALID_FIFO_BUFFER_SIZE;
+
+    // make the storage medium accessible up to the FIFO end
+    dev.begin((size_t)(pSlots + slots * slotSize));
+
+    dev.write(pMarker,FORMAT_FIXED);
+    dev.write(pMarker + 1,(uint8_t)RecordSize);
+    dev.write(pMarker + 2,(uint8_t)(RecordSize >> 8));
+
+    // all slots free, as pushed in the previous lap
+    for (size_t i = 0; i < slots; i++)
+      dev.write(statusPtr(i),SLOT_FREE | SLOT_LAP | SLOT_PATTERN);
+
+    pushSlot = 0;
+    popSlot = 0;
+    usedSlots = 0;
+    readSlots = 0;
+    pushLap = 0;
+
+    dev.changed(FIXED_METADATA_SIZE + slots);
+
+    return commit();
+
+  }
+
+
+  int begin(void) {
+  /* check the metadata and find the FIFO queue head and tail from the
+   * status bytes of the slots: the push slot is the first slot with a lap
+   * bit different from the first slot, the used slots end just before it.
+   */
+
+    if (!slots)
+      return INVALID_FIFO_BUFFER_SIZE;
+
+    // make the storage medium accessible up to the FIFO end
+    dev.begin((size_t)(pSlots + slots * slotSize));
+
+    if (dev.read(pMarker) != FORMAT_FIXED ||
+      (dev.read(pMarker + 1) | (size_t)dev.read(pMarker + 2) << 8) !=
+      RecordSize)
+      return INVALID_FORMAT;
+
+    // scan the status bytes for the lap change, count used slots
+    uint8_t firstLap = dev.read(statusPtr(0)) & SLOT_LAP;
+    size_t lapChange = 0;
+    size_t used = 0;
+    for (size_t i = 0; i < slots; i++) {
+
+      uint8_t status = dev.read(statusPtr(i));
+      if ((status & SLOT_PATTERN) != SLOT_PATTERN)
+        return INVALID_BLOCK_HEADER;
+
+      if ((status & SLOT_LAP) != firstLap) {
+        if (!lapChange)
+          lapChange = i;
+      }
+      else if (lapChange)
+        return INVALID_BLOCK_HEADER;
+
+      if (!(status & SLOT_FREE))
+        used++;
+    }
+
+    // no lap change: all slots were pushed in the same lap, a new one
+    // starts from the first slot
+    pushSlot = lapChange;
+    pushLap = lapChange ? firstLap : firstLap ^ SLOT_LAP;
+
+    // the used slots must be the ones just before the push slot
+    popSlot = (pushSlot + slots - used) % slots;
+    for (size_t i = 0; i < used; i++)
+      if (dev.read(statusPtr((popSlot + i) % slots)) & SLOT_FREE)
+        return INVALID_BLOCK_HEADER;
+
+    usedSlots = used;
+    readSlots = 0;
+
+    return SUCCESS;
+
+  }
+
+
+  int push(uint8_t *data) {
+  /* push a record: write the record into the push slot, then its status
+   * byte as used.
+   */
+
+    if (usedSlots == slots)
+      return FIFO_FULL;
+
+    uint8_t *pStatus = statusPtr(pushSlot);
+    dev.writeBlock(pStatus + 1,data,RecordSize);
+    dev.write(pStatus,pushLap | SLOT_PATTERN);
+    dev.changed(slotSize);
+
+    if (++pushSlot == slots) {
+      pushSlot = 0;
+      pushLap ^= SLOT_LAP;
+    }
+    usedSlots++;
+
+    return commitIfDue();
+
+  }
+
+
+  int pop(uint8_t *data) {
+  /* pop out a record: copy the record at the FIFO queue head to the given
+   * buffer, then mark its slot as free.
+   */
+
+    if (!usedSlots)
+      return FIFO_EMPTY;
+
+    dev.readBlock(statusPtr(popSlot) + 1,data,RecordSize);
+
+    return consume();
+
+  }
+
+
+  int consume(void) {
+  /* pop out the record at the FIFO queue head without reading it: only
+   * the slot status byte is written.
+   */
+
+    if (!usedSlots)
+      return FIFO_EMPTY;
+
+    // slots from the push slot on were pushed in the previous lap
+    uint8_t lap = popSlot < pushSlot ? pushLap : pushLap ^ SLOT_LAP;
+    dev.write(statusPtr(popSlot),SLOT_FREE | lap | SLOT_PATTERN);
+    dev.changed(1);
+
+    popSlot = (popSlot + 1) % slots;
+    usedSlots--;
+    if (readSlots)
+      readSlots--;
+
+    return commitIfDue();
+
+  }
+
+
+  int read(uint8_t *data) {
+  /* read a record: copy the record at the read position to the given
+   * buffer and move the read position to the next record.
+   */
+
+    if (readSlots == usedSlots)
+      return FIFO_EMPTY;
+
+    dev.readBlock(statusPtr((popSlot + readSlots) % slots) + 1,data,
+      RecordSize);
+    readSlots++;
+
+    return SUCCESS;
+
+  }
+
+
+  void restartRead(void) {
+  /* the read position is moved to the oldest record, the FIFO queue head.
+   */
+
+    readSlots = 0;
+
+  }
+
+
+  size_t blockCount(void) {
+  /* number of records into FIFO
+   */
+
+    return usedSlots;
+
+  }
+
+
+  size_t slotCount(void) {
+  /* number of slots, the FIFO capacity in records
+   */
+
+    return slots;
+
+  }
+
+
+  int flush(void) {
+  /* commit now all pending changes to EEPROM, see FIFOEE flush.
+   */
+
+    if (dev.pending())
+      return commit();
+
+    return SUCCESS;
+
+  }
+
+
+  int poll(void) {
+  /* commit pending changes to EEPROM if their commit deadline is passed,
+   * see FIFOEE poll.
+   */
+
+    return commitIfDue();
+
+  }
+
+
+  bool pending(void) {
+  /* return true if there are changes not yet committed to EEPROM.
+   */
+
+    return dev.pending();
+
+  }
+
+
+  void setCommitThreshold(size_t maxDirtyBytes) {
+  /* commit as soon as the changed bytes reach the given threshold, zero
+   * disables. Only for ESP8266 and ESP32.
+   */
+
+    dev.setCommitThreshold(maxDirtyBytes);
+
+  }
+
+
+  uint32_t commitCount(void) {
+  /* return the number of commits done since object creation. Only for
+   * ESP8266 and ESP32.
+   */
+
+    return dev.commitCount();
+
+  }
+
+
+  private:
+
+  void init(uint8_t *aBuffer,size_t aBufSize) {
+  /* init control vars, common to all constructors
+   */
+
+    pMarker = aBuffer;
+    pSlots = aBuffer + FIXED_METADATA_SIZE;
+    slots = aBufSize > FIXED_METADATA_SIZE ?
+      (aBufSize - FIXED_METADATA_SIZE) / slotSize : 0;
+    pushSlot = 0;
+    popSlot = 0;
+    usedSlots = 0;
+    readSlots = 0;
+    pushLap = 0;
+
+  }
+
+
+  uint8_t *statusPtr(size_t slot) {
+
+    return pSlots + slot * slotSize;
+
+  }
+
+
+  int commitIfDue(void) {
+
+    if (dev.commitDue())
+      return commit();
+
+    return SUCCESS;
+
+  }
+
+
+  int commit(void) {
+
+    if (!dev.commit())
+      return COMMIT_FAILURE;
+
+    return SUCCESS;
+
+  }
+
+};
+
+
+/**** default fixed record FIFOEE class of the board ****/
+
+template <size_t RecordSize>
+using FIFOEEFixed = BasicFIFOEEFixed<RecordSize,FIFOEE::backendType>;
+
+#endif
+
+/**** end ****/
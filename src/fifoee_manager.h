@@ -0,0 +1,474 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : FIFOEE manager of multiple FIFOs sharing one EEPROM
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  A FIFOEE manager owns one EEPROM region with a small partition table at
+  its start and gives numbered FIFOs allocated into the region. The
+  storage medium is begun once for the whole region and all the FIFOs
+  share the same commit scheduler: on ESP8266 and ESP32, the changes of
+  all the FIFOs are written to flash by a single EEPROM commit, e.g.
+    #include <fifoee_manager.h>
+    FIFOEEManager manager((uint8_t *)0,4096,10000);
+    FIFOEEManager::Fifo *events, *samples;
+    ...
+    if (manager.begin())
+      manager.format();
+    manager.open(1,512,&events);
+    manager.open(2,2048,&samples);
+
+  Compile options, define before the include:
+  1. maximum number of partitions, define symbol FIFOEE_PARTITIONS as
+  its value (default 4).
+
+.- */
+
+#ifndef FIFOEE_MANAGER_H
+#define FIFOEE_MANAGER_H
+
+#include <new>
+#include "fifoee.h"
+
+
+/**** constants ****/
+
+#ifndef FIFOEE_PARTITIONS
+  #define FIFOEE_PARTITIONS 4
+#endif
+
+// partition table: marker, number of partitions, partition entries of
+// id, offset and size (2 bytes each, lsb first)
+#define PARTITION_TABLE_MARKER 0xA5
+#define PARTITION_ENTRY_SIZE 5
+#define PARTITION_TABLE_SIZE (2 + FIFOEE_PARTITIONS * PARTITION_ENTRY_SIZE)
+
+
+/**** backend ****/
+
+template <class Backend>
+struct FIFOEESharedBackend {
+/* FIFO into a partition of a FIFOEE manager: all accesses go to the
+ * backend of the manager, which begins the storage medium and schedules
+ * the commits of all the partitions.
+ */
+
+  Backend *shared;
+
+  explicit FIFOEESharedBackend(Backend *aShared = NULL): shared(aShared) {}
+
+  // the manager begins the whole region
+  void begin(size_t) {}
+
+  uint8_t read(const uint8_t *addr) { return shared->read(addr); }
+  void write(uint8_t *addr,uint8_t val) { shared->write(addr,val); }
+  void readBlock(const uint8_t *addr,uint8_t *buf,size_t size) {
+    shared->readBlock(addr,buf,size);
+  }
+  void writeBlock(uint8_t *addr,const uint8_t *buf,size_t size) {
+    shared->writeBlock(addr,buf,size);
+  }
+  const uint8_t *dataPtr(const uint8_t *addr) {
+    return shared->dataPtr(addr);
+  }
+
+  void changed(size_t size) { shared->changed(size); }
+  bool commitDue(void) { return shared->commitDue(); }
+  bool pending(void) { return shared->pending(); }
+  bool commit(void) { return shared->commit(); }
+
+};
+
+
+/**** class ****/
+
+template <class Backend>
+struct BasicFIFOEEManager: FIFOEEBase {
+
+  public:
+
+  // the FIFO class of the partitions
+  typedef BasicFIFOEE<FIFOEESharedBackend<Backend> > Fifo;
+
+  private:
+
+  /**** class control vars ****/
+
+  uint8_t *pTable;
+  size_t bufSize;
+  uint8_t partitions;
+
+  // FIFO objects of the opened partitions
+  uint8_t fifoIds[FIFOEE_PARTITIONS];
+  bool fifoOpen[FIFOEE_PARTITIONS];
+  alignas(Fifo) uint8_t fifoMem[FIFOEE_PARTITIONS][sizeof(Fifo)];
+
+  Backend dev;
+
+
+  /**** class member functions ****/
+
+  public:
+
+  BasicFIFOEEManager(uint8_t *aBuffer,size_t aBufSize) {
+  /* class constructor
+   * aBuffer: region start address, area for partition table and FIFOs.
+   * aBufSize: region size (bytes).
+   */
+
+    init(aBuffer,aBufSize);
+
+  }
+
+
+  BasicFIFOEEManager(uint8_t *aBuffer,size_t aBufSize,
+    uint32_t aCommitPeriod): dev(aCommitPeriod) {
+  /* class constructor for emulated EEPROM (ESP8266 and ESP32)
+   * aCommitPeriod: max delay (ms) from a change in any partition to its
+   *   real write to EEPROM (commit), zero disables timed commits.
+   */
+
+    init(aBuffer,aBufSize);
+
+  }
+
+
+  BasicFIFOEEManager(uint8_t *aBuffer,size_t aBufSize,const Backend &aDev):
+    dev(aDev) {
+  /* class constructor with a given backend instance
+   * aDev: backend, i.e. an external EEPROM with its bus address.
+   */
+
+    init(aBuffer,aBufSize);
+
+  }
+
+
+  ~BasicFIFOEEManager() {
+
+    close();
+
+  }
+
+
+  int format(void) {
+  /* clear the partition table: all partitions and their FIFOs are
+   * deleted.
+   */
+
+    if (bufSize < PARTITION_TABLE_SIZE)
+      return INVALID_FIFO_BUFFER_SIZE;
+
+    close();
+
+    // make the storage medium accessible up to the region end
+    dev.begin((size_t)(pTable + bufSize));
+
+    dev.write(pTable,PARTITION_TABLE_MARKER);
+    dev.write(pTable + 1,0);
+    dev.changed(2);
+    partitions = 0;
+
+    if (!dev.commit())
+      return COMMIT_FAILURE;
+
+    return SUCCESS;
+
+  }
+
+
+  int begin(void) {
+  /* begin the storage medium for the whole region and check the
+   * partition table. To be called at power up before any open.
+   */
+
+    if (bufSize < PARTITION_TABLE_SIZE)
+      return INVALID_FIFO_BUFFER_SIZE;
+
+    close();
+
+    // make the storage medium accessible up to the region end
+    dev.begin((size_t)(pTable + bufSize));
+
+    if (dev.read(pTable) != PARTITION_TABLE_MARKER)
+      return INVALID_FORMAT;
+    partitions = dev.read(pTable + 1);
+    if (partitions > FIFOEE_PARTITIONS)
+      return INVALID_FORMAT;
+
+    // partitions must be in sequence after the table
+    size_t end = PARTITION_TABLE_SIZE;
+    for (uint8_t i = 0; i < partitions; i++) {
+      size_t offset,size;
+      readEntry(i,&offset,&size);
+      if (offset != end || offset + size > bufSize)
+        return INVALID_FORMAT;
+      end += size;
+    }
+
+    return SUCCESS;
+
+  }
+
+
+  int open(uint8_t id,size_t size,Fifo **fifo) {
+  /* give the FIFO of the partition with the given id. An existing FIFO
+   * is begun, a new partition is allocated after the last one and its
+   * FIFO is formatted. If the begin or the format fails, the FIFO is not
+   * kept open and fifo is set to NULL, a new partition is not allocated.
+   * id: partition number, chosen by the application.
+   * size: partition size (bytes), i.e. the FIFO buffer size.
+   * fifo: set to the FIFO of the partition.
+   */
+
+    // already open
+    for (uint8_t slot = 0; slot < FIFOEE_PARTITIONS; slot++)
+      if (fifoOpen[slot] && fifoIds[slot] == id) {
+        *fifo = fifoAt(slot);
+        return SUCCESS;
+      }
+
+    // find a free FIFO object
+    uint8_t slot = 0;
+    while (slot < FIFOEE_PARTITIONS && fifoOpen[slot])
+      slot++;
+    if (slot == FIFOEE_PARTITIONS)
+      return NO_PARTITION_SPACE;
+
+    // find the partition or the end of the last one
+    size_t offset = PARTITION_TABLE_SIZE;
+    size_t partSize = 0;
+    uint8_t i;
+    for (i = 0; i < partitions; i++) {
+      readEntry(i,&offset,&partSize);
+      if (dev.read(entry(i)) == id)
+        break;
+      offset += partSize;
+    }
+
+    // existing partition: begin its FIFO
+    if (i < partitions) {
+      if (partSize != size)
+        return WRONG_RBUFFER_SIZE;
+      *fifo = create(slot,id,pTable + offset,size);
+      return opened(slot,(*fifo)->begin(),fifo);
+    }
+
+    // new partition: allocate it and format its FIFO
+    if (partitions == FIFOEE_PARTITIONS || offset + size > bufSize)
+      return NO_PARTITION_SPACE;
+    uint8_t *p = entry(partitions);
+    dev.write(p,id);
+    dev.write(p + 1,(uint8_t)offset);
+    dev.write(p + 2,(uint8_t)(offset >> 8));
+    dev.write(p + 3,(uint8_t)size);
+    dev.write(p + 4,(uint8_t)(size >> 8));
+    dev.write(pTable + 1,++partitions);
+    dev.changed(PARTITION_ENTRY_SIZE + 1);
+    *fifo = create(slot,id,pTable + offset,size);
+
+    // the FIFO format commits also the new table entry. If it fails, the
+    // entry is dropped, so a later open can allocate the partition again
+    int rc = (*fifo)->format();
+    if (rc) {
+      dev.write(pTable + 1,--partitions);
+      dev.changed(1);
+    }
+
+    return opened(slot,rc,fifo);
+
+  }
+
+
+  int flush(void) {
+  /* commit now the pending changes of all the partitions, with a single
+   * commit, taking before the checkpoint of each FIFO, if enabled.
+   */
+
+    if (pending())
+      return commit();
+
+    return SUCCESS;
+
+  }
+
+
+  int poll(void) {
+  /* commit the changes of all the partitions, if due. To be called
+   * periodically on ESP8266 and ESP32, see FIFOEE poll.
+   */
+
+    pending();
+    if (dev.commitDue())
+      return commit();
+
+    return SUCCESS;
+
+  }
+
+
+  bool pending(void) {
+  /* return true if any partition has changes not yet committed. In SPSC
+   * mode, the changes pushed into each FIFO are collected here.
+   */
+
+    for (uint8_t slot = 0; slot < FIFOEE_PARTITIONS; slot++)
+      if (fifoOpen[slot])
+        fifoAt(slot)->pending();
+
+    return dev.pending();
+
+  }
+
+
+  uint8_t partitionCount(void) {
+  /* return the number of partitions into the table
+   */
+
+    return partitions;
+
+  }
+
+
+  void setCommitThreshold(size_t maxDirtyBytes) {
+  /* commit the changes of all the partitions as soon as the changed
+   * bytes reach the given threshold, zero disables. Only for ESP8266 and
+   * ESP32.
+   */
+
+    dev.setCommitThreshold(maxDirtyBytes);
+
+  }
+
+
+  uint32_t commitCount(void) {
+  /* return the number of commits done since object creation. Only for
+   * ESP8266 and ESP32.
+   */
+
+    return dev.commitCount();
+
+  }
+
+
+  private:
+
+  void init(uint8_t *aBuffer,size_t aBufSize) {
+  /* init control vars, common to all constructors
+   */
+
+    pTable = aBuffer;
+    bufSize = aBufSize;
+    partitions = 0;
+    for (uint8_t slot = 0; slot < FIFOEE_PARTITIONS; slot++)
+      fifoOpen[slot] = false;
+
+  }
+
+
+  Fifo *fifoAt(uint8_t slot) {
+
+    return reinterpret_cast<Fifo *>(fifoMem[slot]);
+
+  }
+
+
+  Fifo *create(uint8_t slot,uint8_t id,uint8_t *aBuffer,size_t aBufSize) {
+  /* build into the given slot the FIFO object of a partition
+   */
+
+    fifoIds[slot] = id;
+    fifoOpen[slot] = true;
+
+    return new (fifoMem[slot]) Fifo(aBuffer,aBufSize,
+      FIFOEESharedBackend<Backend>(&dev));
+
+  }
+
+
+  int opened(uint8_t slot,int rc,Fifo **fifo) {
+  /* keep open the FIFO of the given slot only if its begin or format
+   * result rc is a success, return rc
+   */
+
+    if (rc) {
+      destroy(slot);
+      *fifo = NULL;
+    }
+
+    return rc;
+
+  }
+
+
+  void destroy(uint8_t slot) {
+  /* destroy the FIFO object of the given slot
+   */
+
+    fifoAt(slot)->~Fifo();
+    fifoOpen[slot] = false;
+
+  }
+
+
+  void close(void) {
+  /* destroy the FIFO objects of all the opened partitions
+   */
+
+    for (uint8_t slot = 0; slot < FIFOEE_PARTITIONS; slot++)
+      if (fifoOpen[slot])
+        destroy(slot);
+
+  }
+
+
+  uint8_t *entry(uint8_t i) {
+
+    return pTable + 2 + i * PARTITION_ENTRY_SIZE;
+
+  }
+
+
+  void readEntry(uint8_t i,size_t *offset,size_t *size) {
+
+    uint8_t *p = entry(i);
+    *offset = dev.read(p + 1) | (size_t)dev.read(p + 2) << 8;
+    *size = dev.read(p + 3) | (size_t)dev.read(p + 4) << 8;
+
+  }
+
+
+  int commit(void) {
+  /* single commit of all the partitions, after the checkpoint of the
+   * opened FIFOs, if enabled
+   */
+
+    #ifdef FIFOEE_CHECKPOINT_SLOTS
+    for (uint8_t slot = 0; slot < FIFOEE_PARTITIONS; slot++)
+      if (fifoOpen[slot])
+        fifoAt(slot)->checkpoint();
+    #endif
+
+    if (!dev.commit())
+      return COMMIT_FAILURE;
+
+    return SUCCESS;
+
+  }
+
+};
+
+
+/**** default FIFOEE manager class of the board ****/
+
+typedef BasicFIFOEEManager<FIFOEE::backendType> FIFOEEManager;
+
+#endif
+
+/**** end ****/
@@ -0,0 +1,324 @@
+/* .+
+
+.context    : FIFOEE, FIFO of variable size data blocks over EEPROM
+.title      : FIFOEE with a RAM staging queue
+.kind       : c++ source
+.author     : Fabrizio Pollastri <mxgbot@gmail.com>
+.site       : Revello - Italy
+.creation   : 14-Oct-2026
+.copyright  : (c) 2026 Fabrizio Pollastri
+.license    : GNU Lesser General Public License
+
+.description
+  Two tier FIFO: pushes go to a small FIFO in RAM (the stage), taking
+  microseconds, and are moved later by poll into a persistent FIFO, so
+  the push latency does not depend on the write cycle time of the
+  storage. Poll can be called from loop or from a background task. With
+  FIFOEE_SPSC defined, push can run in an ISR or a task concurrently with
+  poll. Started by beginStart, the begin of the persistent FIFO is done
+  in steps by poll, while pushes already go to the stage, e.g.
+    #include <fifoee_staged.h>
+    FIFOEE fifo((uint8_t *)0,1024);
+    FIFOEEStaged staged(fifo,256,128,FIFOEEStaged::DROP_OLDEST);
+    ...
+    staged.begin();
+    ...
+    staged.push(data,size);   // sampling ISR
+    ...
+    staged.poll();            // loop
+
+.- */
+
+#ifndef FIFOEE_STAGED_H
+#define FIFOEE_STAGED_H
+
+#include "fifoee.h"
+
+
+/**** class ****/
+
+template <class Fifo>
+struct BasicFIFOEEStaged: FIFOEEBase {
+
+  /**** class constants ****/
+
+  public:
+
+  // what to drop when the stage or the persistent FIFO is full
+  enum dropPolicy: uint8_t {
+
+    DROP_NEWEST = 0,    // reject the incoming block
+    DROP_OLDEST         // delete the oldest blocks to make room
+
+  };
+
+
+  /**** class control vars ****/
+
+  private:
+
+  Fifo &fifo;                             // persistent FIFO
+  BasicFIFOEE<FIFOEERamBackend> stage;    // RAM staging FIFO
+  size_t highWater;
+  uint8_t policy;
+
+  // begin of the persistent FIFO done in steps by poll, blocks per step,
+  // and its result, kept until the next begin
+  bool recovering = false;
+  size_t stepBlocks;
+  int beginError = SUCCESS;
+
+  // dropped blocks, counted separately by the push and poll sides
+  uint32_t stageDrops = 0;
+  uint32_t fifoDrops = 0;
+
+
+  /**** class member functions ****/
+
+  public:
+
+  BasicFIFOEEStaged(Fifo &aFifo,size_t aStageSize,size_t aHighWater = 0,
+    uint8_t aPolicy = DROP_NEWEST):
+    fifo(aFifo), stage((uint8_t *)0,aStageSize), highWater(aHighWater),
+    policy(aPolicy) {
+  /* class constructor
+   * aFifo: persistent FIFO, receiving the staged blocks.
+   * aStageSize: RAM stage size (bytes), metadata included.
+   * aHighWater: staged bytes from which poll moves blocks to the
+   *   persistent FIFO, zero moves them at each poll.
+   * aPolicy: drop policy on overflow, DROP_NEWEST or DROP_OLDEST.
+   */
+
+    // staged blocks are moved by peek, that gives raw data only
+    #ifdef FIFOEE_COMPRESS
+    stage.setCompression(false);
+    #endif
+
+  }
+
+
+  int begin(void) {
+  /* clear the stage and begin the persistent FIFO, that must be already
+   * formatted. If the begin fails, poll and flush return its error and
+   * move no block until a later begin succeeds.
+   */
+
+    if (int rc = stage.format())
+      return rc;
+    if (int rc = stage.begin())
+      return rc;
+
+    recovering = false;
+    beginError = fifo.begin();
+
+    return beginError;
+
+  }
+
+
+  int beginStart(size_t aStepBlocks) {
+  /* clear the stage and start a resumable begin of the persistent FIFO,
+   * carried on by poll scanning aStepBlocks blocks at each call. Pushes
+   * are accepted at once and wait in the stage until the begin completes.
+   * Return IN_PROGRESS while the begin is in progress, see FIFOEE
+   * beginStart.
+   */
+
+    if (int rc = stage.format())
+      return rc;
+    if (int rc = stage.begin())
+      return rc;
+
+    stepBlocks = aStepBlocks;
+    int rc = fifo.beginStart();
+    recovering = rc == IN_PROGRESS;
+    beginError = recovering ? SUCCESS : rc;
+
+    return rc;
+
+  }
+
+
+  int push(uint8_t *data,size_t size) {
+  /* push data to the stage. If the stage is full, with DROP_NEWEST policy
+   * the data is dropped and FIFO_FULL is returned, with DROP_OLDEST policy
+   * the oldest staged blocks are dropped until data fits. In SPSC mode,
+   * the DROP_OLDEST policy requires push and poll from the same context.
+   */
+
+    int rc = stage.push(data,size);
+    if (policy == DROP_OLDEST)
+      while (rc == FIFO_FULL && stage.consume() == SUCCESS) {
+        stageDrops++;
+        rc = stage.push(data,size);
+      }
+    if (rc == FIFO_FULL)
+      stageDrops++;
+
+    return rc;
+
+  }
+
+
+  int poll(size_t maxBlocks = (size_t)-1) {
+  /* if the staged bytes reach the high water mark, move up to maxBlocks
+   * staged blocks to the persistent FIFO, then let the persistent FIFO
+   * commit, if due. Call it frequently, from loop or from a background
+   * task. During a resumable begin, poll goes on with it and returns
+   * IN_PROGRESS until it completes.
+   */
+
+    if (int rc = recover(stepBlocks))
+      return rc;
+
+    if (stage.bytesUsed() >= highWater)
+      if (int rc = move(maxBlocks))
+        return rc;
+
+    return fifo.poll();
+
+  }
+
+
+  int flush(void) {
+  /* move all staged blocks to the persistent FIFO and commit now all
+   * pending changes. A resumable begin in progress is completed first.
+   */
+
+    if (int rc = recover((size_t)-1))
+      return rc;
+
+    if (int rc = move((size_t)-1))
+      return rc;
+
+    return fifo.flush();
+
+  }
+
+
+  size_t stagedBlocks(void) {
+  /* return the number of blocks in the stage
+   */
+
+    return stage.blockCount();
+
+  }
+
+
+  size_t stagedBytes(void) {
+  /* return the stage bytes used, block headers included
+   */
+
+    return stage.bytesUsed();
+
+  }
+
+
+  uint32_t dropCount(void) {
+  /* return the number of blocks dropped by overflow
+   */
+
+    return stageDrops + fifoDrops;
+
+  }
+
+
+  void setHighWater(size_t aHighWater) {
+  /* set the staged bytes from which poll moves blocks
+   */
+
+    highWater = aHighWater;
+
+  }
+
+
+  private:
+
+  int recover(size_t maxBlocks) {
+  /* go on with the resumable begin of the persistent FIFO, if any, over
+   * up to maxBlocks blocks. Once ended, return the begin result.
+   */
+
+    if (!recovering)
+      return beginError;
+
+    int rc = fifo.beginStep(maxBlocks);
+    if (rc != IN_PROGRESS) {
+      recovering = false;
+      beginError = rc;
+    }
+
+    return rc;
+
+  }
+
+
+  int move(size_t maxBlocks) {
+  /* move up to maxBlocks blocks from the stage to the persistent FIFO,
+   * each copied directly from the stage ring buffer. If the persistent
+   * FIFO is full, with DROP_NEWEST policy blocks wait in the stage, with
+   * DROP_OLDEST policy the oldest persistent blocks are dropped, each drop
+   * taking one of the maxBlocks steps. A block that cannot fit into the
+   * empty persistent FIFO is dropped.
+   */
+
+    // no block goes to a persistent FIFO not begun
+    if (beginError)
+      return beginError;
+
+    dataBlock spans[2];
+
+    for (size_t moved = 0; moved < maxBlocks; moved++) {
+
+      if (stage.peek(spans) == FIFO_EMPTY)
+        break;
+
+      int rc = fifo.pushSpans(spans,2);
+
+      // no room in the persistent FIFO
+      if (rc == FIFO_FULL) {
+        if (!fifo.blockCount())
+          rc = INVALID_DATA_SIZE;
+        else if (policy == DROP_OLDEST) {
+          int rc = fifo.consume();
+          if (rc && rc != COMMIT_FAILURE)
+            return rc;
+          fifoDrops++;
+          if (rc)
+            return rc;
+          continue;
+        }
+        else
+          return rc;
+      }
+
+      // block never fits, drop it
+      if (rc == INVALID_DATA_SIZE) {
+        stage.consume();
+        fifoDrops++;
+        continue;
+      }
+
+      if (rc && rc != COMMIT_FAILURE)
+        return rc;
+
+      // the block is pushed, also if its commit failed
+      stage.consume();
+      if (rc)
+        return rc;
+    }
+
+    return SUCCESS;
+
+  }
+
+};
+
+
+/**** default staged FIFOEE class of the board ****/
+
+typedef BasicFIFOEEStaged<FIFOEE> FIFOEEStaged;
+
+#endif
+
+/**** end ****/